@@ -0,0 +1,194 @@
+/* AceBench.cpp: ace's archive & loader benchmarks.
+	Generates synthetic resource folders at several file counts & size distributions, then
+	times Generate(), Init() with & without scan_changes, cold & warm LoadContent(),
+	LoadContentBuffer() batches and misses. Results are written as JSON.
+
+	Usage: ace-bench [--quick] [--dir <work folder>] [--out <report.json | ->]
+	Progress & ace's log go to stderr, so '--out -' leaves nothing but the report on stdout.
+	*/
+#include "Bench.h"
+#include <ace.h>
+#include <filesystem>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <string.h>
+
+namespace fs = std::filesystem;
+
+#define BENCH_LEVEL 3
+#define BENCH_BATCH 32
+
+struct Corpus {
+	const char* distribution;
+	int files;
+	size_t min_size;
+	size_t max_size;	// Sizes are log-uniform between both
+};
+
+static const Corpus s_corpora[] = {
+	{ "small", 256, 512, 8 * 1024 },
+	{ "small", 2048, 512, 8 * 1024 },
+	{ "mixed", 256, 1024, 1024 * 1024 },
+	{ "mixed", 1024, 1024, 1024 * 1024 },
+	{ "large", 16, 2 * 1024 * 1024, 8 * 1024 * 1024 },
+};
+
+static const Corpus s_quick_corpora[] = {
+	{ "small", 64, 512, 8 * 1024 },
+	{ "mixed", 64, 1024, 256 * 1024 },
+};
+
+// Text-like, partly repetitive content with some noise: compresses roughly like game data.
+static void FillContent(std::mt19937& rng, std::string& out, size_t size) {
+	static const char* words[] = { "sprite", "frame", "tile", "layer", "voice", "param", "node", "0.5", "1024", "true" };
+	out.clear();
+	out.reserve(size);
+	while (out.size() < size) {
+		if (rng() % 8 == 0) { out += (char)(rng() & 0xFF); }
+		else {
+			out += words[rng() % 10];
+			out += (char)" ,;\n"[rng() % 4];
+		}
+	}
+	out.resize(size);
+}
+
+static size_t MakeCorpus(const Corpus& corpus, const fs::path& dir, std::vector<std::string>& tags) {
+	fs::remove_all(dir);
+	fs::create_directories(dir);
+	std::mt19937 rng(corpus.files);
+	std::uniform_real_distribution<double> log_size(log((double)corpus.min_size), log((double)corpus.max_size));
+	std::string content;
+	size_t total = 0;
+	tags.clear();
+	for (int i = 0; i < corpus.files; i++) {
+		char tag[32];
+		snprintf(tag, sizeof(tag), "res%05d", i);
+		FillContent(rng, content, (size_t)exp(log_size(rng)));
+		std::ofstream out(dir / (std::string(tag) + ".wav"), std::ios::out | std::ios::binary);
+		out.write(content.data(), content.size());
+		total += content.size();
+		tags.push_back(tag);
+	}
+	return total;
+}
+
+// Runs 'body' 'repeat' times; 'setup' runs untimed before each repetition.
+template <typename Setup, typename Body>
+static bench::Result Measure(const char* name, int repeat, double ops, double bytes, Setup setup, Body body) {
+	bench::Result result{ name, {}, ops, bytes };
+	for (int i = 0; i < repeat; i++) {
+		setup();
+		bench::Timer timer;
+		body();
+		result.samples.push_back(timer.Seconds());
+	}
+	return result;
+}
+
+int main(int argc, char** argv) {
+	bool quick = false;
+	fs::path work = fs::temp_directory_path() / "ace-bench";
+	std::string report = "ace-bench.json";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) { quick = true; }
+		else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) { work = argv[++i]; }
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) { report = argv[++i]; }
+		else {
+			fprintf(stderr, "Usage: %s [--quick] [--dir <work folder>] [--out <report.json | ->]\n", argv[0]);
+			return 1;
+		}
+	}
+	const int repeat = quick ? 2 : 5;
+	ace::SetLog(stderr);
+
+	bench::Json json;
+	json.BeginObject();
+	json.Field("benchmark", "ace");
+	json.Field("format_version", 1);
+	bench::WriteBuildInfo(json);
+	json.Key("corpora").BeginArray();
+
+	const Corpus* corpora = quick ? s_quick_corpora : s_corpora;
+	const size_t corpus_count = quick ? sizeof(s_quick_corpora) / sizeof(Corpus) : sizeof(s_corpora) / sizeof(Corpus);
+	for (size_t c = 0; c < corpus_count; c++) {
+		const Corpus& corpus = corpora[c];
+		const std::string name = std::string(corpus.distribution) + "-" + std::to_string(corpus.files);
+		const fs::path res = work / name / "res";
+		const fs::path out = work / name;
+		const std::string archive = name;
+		fprintf(stderr, "ACE-BENCH: Preparing corpus %s\n", name.c_str());
+
+		std::vector<std::string> tags;
+		const size_t total_bytes = MakeCorpus(corpus, res, tags);
+		std::vector<const char*> c_tags;
+		for (auto& tag : tags) { c_tags.push_back(tag.c_str()); }
+		std::vector<std::string> misses;
+		for (int i = 0; i < 64; i++) { misses.push_back("missing" + std::to_string(i)); }
+		std::vector<bench::Result> results;
+		auto nothing = []() {};
+
+		results.push_back(Measure("generate", quick ? 1 : 3, (double)tags.size(), (double)total_bytes, nothing, [&]() {
+			ace::Generate(BENCH_LEVEL, res.string().c_str(), out.string().c_str(), archive.c_str());
+		}));
+		const size_t archive_bytes = (size_t)fs::file_size(out / (archive + ".ace"));
+
+		results.push_back(Measure("init_scan_changes", repeat, 1, 0, []() { ace::Stop(); }, [&]() {
+			ace::Init(BENCH_LEVEL, res.string().c_str(), out.string().c_str(), archive.c_str(), true);
+		}));
+		results.push_back(Measure("init", repeat, 1, 0, []() { ace::Stop(); }, [&]() {
+			ace::Init(BENCH_LEVEL, res.string().c_str(), out.string().c_str(), archive.c_str(), false);
+		}));
+
+		// Cold: the first pass after mounting; warm: the same entries again right after.
+		auto remount = [&]() {
+			ace::Stop();
+			ace::Init(BENCH_LEVEL, res.string().c_str(), out.string().c_str(), archive.c_str(), false);
+		};
+		auto load_all = [&]() {
+			for (auto& tag : tags) { ace::LoadContent(tag.c_str()); }
+		};
+		results.push_back(Measure("load_content_cold", repeat, (double)tags.size(), (double)total_bytes, remount, load_all));
+		results.push_back(Measure("load_content_warm", repeat, (double)tags.size(), (double)total_bytes, nothing, load_all));
+
+		results.push_back(Measure("load_content_buffer", repeat, (double)tags.size(), (double)total_bytes, nothing, [&]() {
+			for (size_t i = 0; i < c_tags.size(); i += BENCH_BATCH) {
+				const int count = (int)std::min((size_t)BENCH_BATCH, c_tags.size() - i);
+				ace_buffer batch = ace::LoadContentBuffer(c_tags.data() + i, count);
+			}
+		}));
+		results.push_back(Measure("load_content_arena", repeat, (double)tags.size(), (double)total_bytes, nothing, [&]() {
+			for (size_t i = 0; i < c_tags.size(); i += BENCH_BATCH) {
+				const int count = (int)std::min((size_t)BENCH_BATCH, c_tags.size() - i);
+				ace_buffer batch = ace::LoadContentArena(c_tags.data() + i, count);
+			}
+		}));
+		// Every miss logs its error lines; silenced so the loader is all that's timed.
+		ace::SetLog(NULL);
+		results.push_back(Measure("load_content_miss", repeat, (double)misses.size(), 0, nothing, [&]() {
+			for (auto& miss : misses) { ace::LoadContent(miss.c_str()); }
+		}));
+		ace::SetLog(stderr);
+		ace::Stop();
+
+		json.BeginObject();
+		json.Field("name", name);
+		json.Field("distribution", corpus.distribution);
+		json.Field("files", corpus.files);
+		json.Field("source_bytes", total_bytes);
+		json.Field("archive_bytes", archive_bytes);
+		json.Key("results").BeginArray();
+		for (auto& result : results) {
+			json.Write(result);
+			fprintf(stderr, "ACE-BENCH: %-12s %-22s p50 %10.3f ms\n", name.c_str(), result.name.c_str(), result.Percentile(0.5) * 1e3);
+		}
+		json.EndArray();
+		json.EndObject();
+		fs::remove_all(out);
+	}
+	json.EndArray();
+	json.EndObject();
+
+	return bench::SaveReport(json, report) ? 0 : 1;
+}
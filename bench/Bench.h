@@ -0,0 +1,154 @@
+/* Bench.h: timing, statistics & JSON output shared by the benchmark targets.
+	Every benchmark records one sample per repetition; reports keep plain summary numbers so
+	runs from different releases can be compared by scripts.
+	*/
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <stdio.h>
+
+namespace bench {
+
+class Timer {
+	std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+
+public:
+	void Restart() { start_ = std::chrono::steady_clock::now(); }
+	double Seconds() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count(); }
+};
+
+/* Result:
+	Samples of one benchmark; 'ops' & 'bytes' are what a single sample processed, and turn
+	into per-operation times & throughput.
+	*/
+struct Result {
+	std::string name;
+	std::vector<double> samples;	// Seconds
+	double ops = 1;
+	double bytes = 0;
+
+	double Percentile(double p) const {
+		if (samples.empty()) { return 0; }
+		std::vector<double> sorted(samples);
+		std::sort(sorted.begin(), sorted.end());
+		return sorted[(size_t)(p * (sorted.size() - 1) + 0.5)];
+	}
+
+	double Mean() const {
+		double sum = 0;
+		for (double s : samples) { sum += s; }
+		return samples.empty() ? 0 : sum / samples.size();
+	}
+};
+
+/* Json:
+	Minimal streaming writer; separators are handled, indentation isn't.
+	*/
+class Json {
+	std::string out_;
+	std::vector<bool> first_;	// Per open object/array: nothing written to it yet
+	bool after_key_ = false;
+
+	void Separate() {
+		if (after_key_) {
+			after_key_ = false;
+			return;
+		}
+		if (!first_.empty()) {
+			if (!first_.back()) { out_ += ','; }
+			first_.back() = false;
+		}
+	}
+
+	void String(const char* value) {
+		out_ += '"';
+		for (const char* c = value; *c; c++) {
+			if (*c == '"' || *c == '\\') { out_ += '\\'; out_ += *c; }
+			else if ((unsigned char)*c < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+				out_ += escaped;
+			}
+			else { out_ += *c; }
+		}
+		out_ += '"';
+	}
+
+public:
+	Json& BeginObject() { Separate(); out_ += '{'; first_.push_back(true); return *this; }
+	Json& EndObject() { out_ += '}'; first_.pop_back(); return *this; }
+	Json& BeginArray() { Separate(); out_ += '['; first_.push_back(true); return *this; }
+	Json& EndArray() { out_ += ']'; first_.pop_back(); return *this; }
+	Json& Key(const char* key) { Separate(); String(key); out_ += ':'; after_key_ = true; return *this; }
+
+	Json& Value(const char* value) { Separate(); String(value); return *this; }
+	Json& Value(const std::string& value) { return Value(value.c_str()); }
+	Json& Value(bool value) { Separate(); out_ += value ? "true" : "false"; return *this; }
+	Json& Value(double value) {
+		Separate();
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.6g", value);
+		out_ += buffer;
+		return *this;
+	}
+	template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+	Json& Value(T value) { Separate(); out_ += std::to_string(value); return *this; }
+
+	template <typename T>
+	Json& Field(const char* key, T value) { return Key(key).Value(value); }
+
+	// Summary of a result: times in milliseconds per sample, plus per-op & throughput figures.
+	Json& Write(const Result& result) {
+		BeginObject();
+		Field("name", result.name);
+		Field("samples", result.samples.size());
+		Field("ops_per_sample", result.ops);
+		Field("mean_ms", result.Mean() * 1e3);
+		Field("min_ms", result.Percentile(0) * 1e3);
+		Field("p50_ms", result.Percentile(0.5) * 1e3);
+		Field("p95_ms", result.Percentile(0.95) * 1e3);
+		Field("max_ms", result.Percentile(1) * 1e3);
+		Field("mean_us_per_op", result.Mean() * 1e6 / result.ops);
+		if (result.bytes > 0) { Field("mb_per_s", result.bytes / (1024.0 * 1024.0) / result.Percentile(0.5)); }
+		return EndObject();
+	}
+
+	const std::string& str() const { return out_; }
+};
+
+// Build information worth keeping next to the numbers.
+inline void WriteBuildInfo(Json& json) {
+	json.Key("build").BeginObject();
+#if defined(NDEBUG)
+	json.Field("config", "release");
+#else
+	json.Field("config", "debug");
+#endif
+#if defined(_MSC_VER)
+	json.Field("compiler", "msvc " + std::to_string(_MSC_VER));
+#elif defined(__clang__)
+	json.Field("compiler", "clang " __clang_version__);
+#elif defined(__GNUC__)
+	json.Field("compiler", "gcc " __VERSION__);
+#endif
+	json.Field("pointer_bits", (int)(sizeof(void*) * 8));
+	json.EndObject();
+}
+
+// Writes the report to 'path', or to stdout when it's "-".
+inline bool SaveReport(const Json& json, const std::string& path) {
+	FILE* file = path == "-" ? stdout : fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		fprintf(stderr, "ERROR AT " __FUNCTION__ ": Could not write the report! (%s)\n", path.c_str());
+		return false;
+	}
+	fwrite(json.str().data(), 1, json.str().size(), file);
+	fputc('\n', file);
+	if (file != stdout) { fclose(file); }
+	return true;
+}
+
+}
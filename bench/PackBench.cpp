@@ -0,0 +1,356 @@
+/* PackBench.cpp: packing benchmarks for rbp::MaxRectsBinPack & lsqueezer's headless pipeline.
+	Packs synthetic sprite distributions (uniform, power-law) and optional real-world dumps
+	with every MaxRects heuristic and, for the smaller sets, runs ls::BuildAtlas() end to end.
+	Each run reports its time, occupancy & peak heap use as JSON.
+
+	Usage: lsqueezer-bench [--quick | --full] [--dump <sizes.txt | image folder>]... [--out <report.json | ->]
+	* A sizes file has one "width height" pair per line; a folder is scanned for PNG, QOI & BMP
+	  headers. --full adds the 100k rect sets, which take a while with MaxRects.
+	*/
+#include "Bench.h"
+#include <lsqueezer/MaxRectsBinPack.h>
+#include <lsqueezer/atlas_builder.h>
+#include <aceconfig.h>	// ACE_INSTRUMENT
+#include <atomic>
+#include <errno.h>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <new>
+#include <random>
+#include <string.h>
+
+namespace fs = std::filesystem;
+
+// Heap use of everything allocated through malloc() & friends: operator new, the decoded
+// sprites & the atlas pages alike. glibc lets programs replace malloc(); elsewhere only operator
+// new can be counted, and the report says so (see 'heap_counts').
+static std::atomic<size_t> s_heap_current(0);
+static std::atomic<size_t> s_heap_peak(0);
+
+static void HeapAdd(size_t size) {
+	const size_t current = s_heap_current += size;
+	size_t peak = s_heap_peak;
+	while (current > peak && !s_heap_peak.compare_exchange_weak(peak, current)) {}
+}
+
+#if defined(__GLIBC__)
+#include <malloc.h>	// malloc_usable_size()
+#define BENCH_HEAP_COUNTS "malloc"
+
+extern "C" {
+	void* __libc_malloc(size_t size);
+	void* __libc_calloc(size_t count, size_t size);
+	void* __libc_realloc(void* ptr, size_t size);
+	void* __libc_memalign(size_t alignment, size_t size);
+	void* __libc_valloc(size_t size);
+	void* __libc_pvalloc(size_t size);
+	void __libc_free(void* ptr);
+
+	// Blocks are counted at their usable size, so nothing needs to be stored next to them.
+	static void* Counted(void* ptr) {
+		if (ptr != nullptr) { HeapAdd(malloc_usable_size(ptr)); }
+		return ptr;
+	}
+
+	void* malloc(size_t size) { return Counted(__libc_malloc(size)); }
+	void* calloc(size_t count, size_t size) { return Counted(__libc_calloc(count, size)); }
+	void* memalign(size_t alignment, size_t size) { return Counted(__libc_memalign(alignment, size)); }
+	void* aligned_alloc(size_t alignment, size_t size) { return Counted(__libc_memalign(alignment, size)); }
+	void* valloc(size_t size) { return Counted(__libc_valloc(size)); }
+	void* pvalloc(size_t size) { return Counted(__libc_pvalloc(size)); }
+	int posix_memalign(void** out, size_t alignment, size_t size) {
+		void* ptr = Counted(__libc_memalign(alignment, size));
+		if (ptr == nullptr) { return ENOMEM; }
+		*out = ptr;
+		return 0;
+	}
+	void* realloc(void* ptr, size_t size) {
+		const size_t old_size = ptr != nullptr ? malloc_usable_size(ptr) : 0;
+		void* moved = __libc_realloc(ptr, size);
+		if (moved == nullptr && size != 0) { return nullptr; }	// 'ptr' is left as it was
+		s_heap_current -= old_size;
+		return Counted(moved);
+	}
+	void free(void* ptr) {
+		if (ptr == nullptr) { return; }
+		s_heap_current -= malloc_usable_size(ptr);
+		__libc_free(ptr);
+	}
+}
+#else
+#define BENCH_HEAP_COUNTS "operator_new"
+#define BENCH_HEAP_HEADER 16	// Keeps the size in front of each block, & blocks 16-byte aligned
+
+void* operator new(size_t size) {
+	unsigned char* block = (unsigned char*)malloc(size + BENCH_HEAP_HEADER);
+	if (block == nullptr) { throw std::bad_alloc(); }
+	memcpy(block, &size, sizeof(size_t));
+	HeapAdd(size);
+	return block + BENCH_HEAP_HEADER;
+}
+
+void operator delete(void* ptr) noexcept {
+	if (ptr == nullptr) { return; }
+	unsigned char* block = (unsigned char*)ptr - BENCH_HEAP_HEADER;
+	size_t size;
+	memcpy(&size, block, sizeof(size_t));
+	s_heap_current -= size;
+	free(block);
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+void operator delete(void* ptr, size_t) noexcept { operator delete(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { operator delete(ptr); }
+#endif
+
+// Peak heap use from here on, above what's already allocated.
+class HeapScope {
+	size_t base_ = s_heap_current;
+
+public:
+	HeapScope() { s_heap_peak = base_; }
+	size_t Peak() const { return s_heap_peak - base_; }
+};
+
+static const char* s_heuristics[] = { "short_side_fit", "long_side_fit", "area_fit", "bottom_left", "contact_point" };
+
+struct Distribution {
+	std::string name;
+	std::vector<rbp::RectSize> sizes;
+};
+
+static std::vector<rbp::RectSize> Uniform(std::mt19937& rng, int count) {
+	std::uniform_int_distribution<int> side(4, 64);
+	std::vector<rbp::RectSize> sizes(count);
+	for (auto& size : sizes) { size = { side(rng), side(rng) }; }
+	return sizes;
+}
+
+// Lots of small sprites and a few large ones: area follows a Pareto distribution (alpha 1.5).
+static std::vector<rbp::RectSize> PowerLaw(std::mt19937& rng, int count) {
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::vector<rbp::RectSize> sizes(count);
+	for (auto& size : sizes) {
+		const double area = std::min(64.0 * pow(1.0 - unit(rng), -1.0 / 1.5), 256.0 * 256.0);
+		const double aspect = exp((unit(rng) - 0.5) * 1.4);	// About 1:2 to 2:1
+		size.width = std::max(1, (int)sqrt(area * aspect));
+		size.height = std::max(1, (int)sqrt(area / aspect));
+	}
+	return sizes;
+}
+
+static bool LoadDump(const std::string& path, Distribution& out) {
+	out.name = "dump-" + fs::path(path).filename().string();
+	std::error_code error;
+	if (fs::is_directory(path, error)) {
+		for (auto& entry : fs::directory_iterator(path, error)) {
+			if (!entry.is_regular_file()) { continue; }
+			unsigned char header[32] = { 0 };
+			std::ifstream in(entry.path(), std::ios::in | std::ios::binary);
+			in.read((char*)header, sizeof(header));
+			int width, height;
+			if (ls::ReadImageSize(header, (size_t)in.gcount(), width, height)) { out.sizes.push_back({ width, height }); }
+		}
+	}
+	else {
+		std::ifstream in(path);
+		int width, height;
+		while (in >> width >> height) {
+			if (width > 0 && height > 0) { out.sizes.push_back({ width, height }); }
+		}
+	}
+	if (out.sizes.empty()) {
+		fprintf(stderr, "ERROR AT " __FUNCTION__ ": No sprite sizes found in dump! (%s)\n", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+// Smallest power-of-two bin, as square as possible, whose area leaves 'slack' on top of the rects'.
+static rbp::RectSize BinFor(const std::vector<rbp::RectSize>& sizes, double slack) {
+	double area = 0;
+	int widest = 1, tallest = 1;
+	for (auto& size : sizes) {
+		area += (double)size.width * size.height;
+		widest = std::max(widest, size.width);
+		tallest = std::max(tallest, size.height);
+	}
+	rbp::RectSize bin = { 1, 1 };
+	while ((double)bin.width * bin.height < area * slack || bin.width < widest || bin.height < tallest) {
+		if (bin.width <= bin.height) { bin.width *= 2; }
+		else { bin.height *= 2; }
+	}
+	return bin;
+}
+
+static void WriteCommon(bench::Json& json, const bench::Result& result, rbp::RectSize bin, size_t placed, size_t count, double occupancy, size_t heap) {
+	json.Field("bin_width", bin.width);
+	json.Field("bin_height", bin.height);
+	json.Field("rects", count);
+	json.Field("placed", placed);
+	json.Field("occupancy", occupancy);
+	json.Field("peak_heap_bytes", heap);
+	json.Key("time").Write(result);
+}
+
+static void BenchMaxRects(bench::Json& json, const Distribution& dist, rbp::RectSize bin, int repeat) {
+	for (int method = 0; method < 5; method++) {
+		bench::Result result{ s_heuristics[method], {}, (double)dist.sizes.size(), 0 };
+		size_t placed = 0, heap = 0;
+		double occupancy = 0;
+		for (int r = 0; r < repeat; r++) {
+			HeapScope scope;
+			bench::Timer timer;
+			rbp::MaxRectsBinPack pack(bin.width, bin.height, true);
+			placed = 0;
+			for (auto& size : dist.sizes) {
+				if (pack.Insert(size.width, size.height, (rbp::MaxRectsBinPack::FreeRectChoiceHeuristic)method).height != 0) { placed++; }
+			}
+			result.samples.push_back(timer.Seconds());
+			occupancy = pack.Occupancy();
+			heap = std::max(heap, scope.Peak());
+		}
+		json.BeginObject();
+		json.Field("stage", "maxrects");
+		json.Field("heuristic", s_heuristics[method]);
+		WriteCommon(json, result, bin, placed, dist.sizes.size(), occupancy, heap);
+		json.EndObject();
+		fprintf(stderr, "LSQUEEZER-BENCH: %-18s %6d rects %-15s %9.3f ms  occupancy %.3f  placed %d\n", dist.name.c_str(),
+			(int)dist.sizes.size(), s_heuristics[method], result.Percentile(0.5) * 1e3, occupancy, (int)placed);
+	}
+}
+
+// Sprites are solid blocks with a random transparent margin, so trimming has work to do.
+static void MakeSprite(size_t i, const rbp::RectSize& size, ls::Bitmap& out) {
+	std::mt19937 rng((unsigned)i);
+	out.width = size.width;
+	out.height = size.height;
+	free(out.pixels);
+	out.pixels = (unsigned char*)calloc((size_t)size.width * size.height, 4);
+	const int margin = std::min(size.width, size.height) / 4 > 0 ? (int)(rng() % (std::min(size.width, size.height) / 4 + 1)) : 0;
+	const uint32_t color = (uint32_t)rng() | 0xFF000000u;
+	for (int y = margin; y < size.height - margin; y++) {
+		for (int x = margin; x < size.width - margin; x++) {
+			memcpy(out.pixels + ((size_t)y * size.width + x) * 4, &color, 4);
+		}
+	}
+}
+
+static void BenchPipeline(bench::Json& json, const Distribution& dist, rbp::RectSize bin, int flags, const char* variant, int repeat) {
+	ls::Source source;
+	source.count = dist.sizes.size();
+	source.name = [](size_t) { return "sprite"; };
+	source.decode = [&](size_t i, ls::Bitmap& out) { MakeSprite(i, dist.sizes[i], out); return true; };
+	source.size = [&](size_t i, int& width, int& height) {
+		width = dist.sizes[i].width;
+		height = dist.sizes[i].height;
+		return true;
+	};
+
+	bench::Result result{ variant, {}, (double)dist.sizes.size(), 0 };
+	size_t placed = 0, heap = 0;
+	double occupancy = 0;
+	bool built = false;
+	ls::ResetStats();
+	for (int r = 0; r < repeat; r++) {
+		HeapScope scope;
+		ls::Page page = { nullptr, 0, 0, 0 };
+		std::vector<AtlasComponent> components;
+		std::vector<bool> loaded;
+		bench::Timer timer;
+		built = ls::BuildAtlas(source, { bin.width, bin.height, flags, false }, page, components, loaded);
+		result.samples.push_back(timer.Seconds());
+		heap = std::max(heap, scope.Peak());
+		free(page.pixels);
+
+		double area = 0;
+		placed = 0;
+		for (size_t i = 0; i < components.size(); i++) {
+			if (!loaded[i]) { continue; }
+			area += (double)components[i].width * components[i].height;
+			placed++;
+		}
+		occupancy = area / ((double)bin.width * bin.height);
+	}
+	json.BeginObject();
+	json.Field("stage", "pipeline");
+	json.Field("variant", variant);
+	json.Field("built", built);
+	json.Field("page_bytes", ls::PageSize(bin.width, bin.height, flags));
+	WriteCommon(json, result, bin, built ? placed : 0, dist.sizes.size(), built ? occupancy : 0, heap);
+#ifdef ACE_INSTRUMENT
+	// Mean time per build spent in each phase.
+	const ls::Stats stats = ls::GetStats();
+	json.Key("phases_ms").BeginObject();
+	json.Field("prepare", stats.prepare_ns / 1e6 / repeat);
+	json.Field("pack", stats.pack_ns / 1e6 / repeat);
+	json.Field("blit", stats.blit_ns / 1e6 / repeat);
+	json.Field("encode", stats.encode_ns / 1e6 / repeat);
+	json.EndObject();
+#endif
+	json.EndObject();
+	fprintf(stderr, "LSQUEEZER-BENCH: %-18s %6d rects %-15s %9.3f ms  %s\n", dist.name.c_str(), (int)dist.sizes.size(), variant,
+		result.Percentile(0.5) * 1e3, built ? "built" : "did not fit");
+}
+
+int main(int argc, char** argv) {
+	bool quick = false, full = false;
+	std::vector<std::string> dumps;
+	std::string report = "lsqueezer-bench.json";
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--quick") == 0) { quick = true; }
+		else if (strcmp(argv[i], "--full") == 0) { full = true; }
+		else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) { dumps.push_back(argv[++i]); }
+		else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) { report = argv[++i]; }
+		else {
+			fprintf(stderr, "Usage: %s [--quick | --full] [--dump <sizes.txt | image folder>]... [--out <report.json | ->]\n", argv[0]);
+			return 1;
+		}
+	}
+	std::vector<int> counts = { 10, 100, 1000, 10000 };
+	if (quick) { counts = { 10, 100, 1000 }; }
+	if (full) { counts.push_back(100000); }
+	const int repeat = quick ? 1 : 3;
+	const size_t pipeline_limit = quick ? 1000 : 10000;	// Beyond that, decoding dominates
+
+	std::vector<Distribution> distributions;
+	std::mt19937 rng(44);
+	for (int count : counts) {
+		distributions.push_back({ "uniform-" + std::to_string(count), Uniform(rng, count) });
+		distributions.push_back({ "power_law-" + std::to_string(count), PowerLaw(rng, count) });
+	}
+	for (auto& path : dumps) {
+		Distribution dump;
+		if (LoadDump(path, dump)) { distributions.push_back(std::move(dump)); }
+	}
+
+	bench::Json json;
+	json.BeginObject();
+	json.Field("benchmark", "lsqueezer");
+	json.Field("format_version", 1);
+	bench::WriteBuildInfo(json);
+	json.Field("heap_counts", BENCH_HEAP_COUNTS);	// What 'peak_heap_bytes' covers
+	json.Key("distributions").BeginArray();
+	for (auto& dist : distributions) {
+		json.BeginObject();
+		json.Field("name", dist.name);
+		json.Field("rects", dist.sizes.size());
+		json.Key("runs").BeginArray();
+		// A tight bin (~10% slack) & a roomy one (~50%), to see where each heuristic gives up.
+		for (double slack : { 1.1, 1.5 }) {
+			const rbp::RectSize bin = BinFor(dist.sizes, slack);
+			BenchMaxRects(json, dist, bin, repeat);
+			if (dist.sizes.size() <= pipeline_limit && bin.width <= 16384 && bin.height <= 16384) {
+				BenchPipeline(json, dist, bin, LS_FLAG_ALLOW_ROTATION, "untrimmed", repeat);
+				BenchPipeline(json, dist, bin, LS_FLAG_ALLOW_ROTATION | LS_FLAG_TRIM, "trimmed", repeat);
+			}
+		}
+		json.EndArray();
+		json.EndObject();
+	}
+	json.EndArray();
+	json.EndObject();
+	return bench::SaveReport(json, report) ? 0 : 1;
+}
@@ -48,7 +48,7 @@ int main(void) {
 
 	{
 		const char* tags[] = { "a", "b", "c", "d", "test" }; // Tags/Content ids
-		LS_Init(EXAMPLE_ATLAS_W, EXAMPLE_ATLAS_H, true);	 // Atlas size & Verbosity
+		LS_InitEx(EXAMPLE_ATLAS_W, EXAMPLE_ATLAS_H, true, LS_FLAG_ALLOW_ROTATION | LS_FLAG_TRIM); // Atlas size, Verbosity & Flags
 
 		// Generate the atlas image
 		Image img = LS_RunTags(tags, 5);
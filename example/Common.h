@@ -23,8 +23,16 @@
 
 // Convenience function
 static inline void EXAMPLE_DrawComponent(Texture2D atlas, AtlasComponent component, Vector2 position, float rotation, Color tint) {
+	if (component.rotated) {
+		// Stored 90° clockwise: sample the swapped region and turn it back counter-clockwise.
+		const Rectangle src = { (float)component.x, (float)component.y, (float)component.height, (float)component.width };
+		const Rectangle dst = { (float)position.x, (float)position.y + component.height, (float)component.height, (float)component.width };
+		const Vector2 origin = { component.y_offset, -component.x_offset };
+		DrawTexturePro(atlas, src, dst, origin, rotation - 90.0f, tint);
+		return;
+	}
 	const Rectangle src = { (float)component.x, (float)component.y, (float)component.width, (float)component.height };
 	const Rectangle dst = { (float)position.x, (float)position.y, (float)component.width, (float)component.height };
-	const Vector2 offset = { component.x_offset, component.y_offset };
-	DrawTexturePro(atlas, src, dst, offset, rotation, tint);
+	const Vector2 origin = { -component.x_offset, -component.y_offset };	// Trimmed pixels are drawn at 'position + offset'
+	DrawTexturePro(atlas, src, dst, origin, rotation, tint);
 }
@@ -46,7 +46,7 @@ int main() {
 
 	{
 		const char* tags[] = { "d", "a", "c", "test", "b" }; // Tags/Content ids (out of order for testing)
-		lsqueezer squeezer(EXAMPLE_ATLAS_W, EXAMPLE_ATLAS_H, true);	 // Atlas size & Verbosity
+		lsqueezer squeezer(EXAMPLE_ATLAS_W, EXAMPLE_ATLAS_H, true, LS_FLAG_ALLOW_ROTATION | LS_FLAG_TRIM); // Atlas size, Verbosity & Flags
 
 		// Generate the atlas image
 		Image img = squeezer.RunTags(tags, 5);
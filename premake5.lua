@@ -69,6 +69,30 @@ project "ace"
 
 		includedirs { "addons/zstd/lib", "addons/zstd/programs", "addons/raylib/src", "addons/md5" }
 
+-- lsqueezer's packing core alone: no raylib, ace or GL, so atlases can be built on headless machines
+project "lsqueezer-core"
+		filter "configurations:Debug OR Release"
+			kind "StaticLib"
+
+		filter "action:gmake*"
+			links { "pthread" }
+
+		filter{}
+
+		language "C++"
+		targetdir "build/%{cfg.buildcfg}/%{cfg.platform}"
+		cppdialect "C++17"
+
+		files { "src/AtlasComponent.h", "src/aceconfig.h", "src/trace.*", "src/lsqueezer/ls_flags.h", "src/lsqueezer/atlas_builder.*",
+				"src/lsqueezer/pixel_ops.*", "src/lsqueezer/block_encoder.*",
+				"src/lsqueezer/MaxRectsBinPack.*", "src/lsqueezer/Rect.*" }
+		vpaths {
+			["Header Files"] = { "**.h" },
+			["Source Files/*"] = { "**.cpp" },
+		}
+
+		includedirs { "addons/raylib/src" }	-- For 'external/stb_image.h' only
+
 project "example-app"
 	kind "ConsoleApp"
 	language "C++"
@@ -95,4 +119,53 @@ project "example-app"
 		libdirs { "addons/raylib/build/%{cfg.buildcfg}/%{cfg.platform}", "build/%{cfg.buildcfg}/%{cfg.platform}" }
 
 	filter "action:gmake*"
-		links { "pthread", "GL", "m", "dl", "rt", "X11" }		
\ No newline at end of file
+		links { "pthread", "GL", "m", "dl", "rt", "X11" }		
+
+-- Benchmarks: write JSON reports (see bench/*.cpp for their options)
+project "ace-bench"
+	kind "ConsoleApp"
+	language "C++"
+	targetdir "bin/%{cfg.buildcfg}/%{cfg.platform}"
+	cppdialect "C++17"
+
+	files { "bench/Bench.h", "bench/AceBench.cpp" }
+	vpaths {
+		["Header Files"] = { "**.h" },
+		["Source Files"] = { "**.cpp" },
+	}
+
+	links { "raylib", "ace" }
+	includedirs { "addons/zstd/lib", "addons/zstd/programs", "addons/raylib/src", "src" }
+
+	filter "action:vs*"
+		defines{ "_CRT_SECURE_NO_WARNINGS", "_WIN32" }
+		dependson { "raylib", "ace" }
+		links { "raylib.lib", "winmm", "kernel32", "ace.lib" }
+		libdirs { "addons/raylib/build/%{cfg.buildcfg}/%{cfg.platform}", "build/%{cfg.buildcfg}/%{cfg.platform}" }
+
+	filter "action:gmake*"
+		links { "pthread", "GL", "m", "dl", "rt", "X11" }
+
+project "lsqueezer-bench"
+	kind "ConsoleApp"
+	language "C++"
+	targetdir "bin/%{cfg.buildcfg}/%{cfg.platform}"
+	cppdialect "C++17"
+
+	files { "bench/Bench.h", "bench/PackBench.cpp" }
+	vpaths {
+		["Header Files"] = { "**.h" },
+		["Source Files"] = { "**.cpp" },
+	}
+
+	links { "lsqueezer-core" }
+	includedirs { "addons/raylib/src", "src" }
+
+	filter "action:vs*"
+		defines{ "_CRT_SECURE_NO_WARNINGS", "_WIN32" }
+		dependson { "lsqueezer-core" }
+		links { "lsqueezer-core.lib" }
+		libdirs { "build/%{cfg.buildcfg}/%{cfg.platform}" }
+
+	filter "action:gmake*"
+		links { "pthread" }
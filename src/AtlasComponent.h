@@ -1,10 +1,16 @@
 #pragma once
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
 
 typedef struct {
-	int width;
-	int height;
+	int width;		// Unrotated width
+	int height;		// Unrotated height
 	int x;
 	int y;
-	float x_offset;
+	float x_offset;		// Distance from the untrimmed top-left corner
 	float y_offset;
-} AtlasComponent;
\ No newline at end of file
+	int source_width;	// Untrimmed size
+	int source_height;
+	bool rotated;	// Stored 90° clockwise; the region inside the atlas is 'height' x 'width'
+} AtlasComponent;
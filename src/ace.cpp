@@ -1,19 +1,50 @@
 #include "ace.h";
 #include "dictionary/dib.h";
+#include "trace.h"
 
 #include <map>
 #include <limits>
 #include <locale>
 #include <sstream>
 #include <fstream>
+#include <iomanip>
 #include <zstd.h>
+#include <common/xxhash.h>
 #include <md5.h>
 #include <stdio.h>
 #include <assert.h>
+#include <list>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <atomic>
+#include <charconv>
+#include <unordered_map>
+#include <unordered_set>
 
-#define EX_ACE_MAX_ALLOC_CAPACITY 256 KB
 #define EX_ACE_STREAMSIZE_MAX LLONG_MAX
 #define EX_ACE_DELIM ','
+// Generate() ends every file with an index record: a regular entry, so readers that walk the
+// file still parse it, whose data is the table of entry offsets followed by the trailer.
+#define EX_ACE_INDEX_ID "<ace-index>"
+#define EX_ACE_INDEX_MAGIC "ACEINDEX"
+#define EX_ACE_TRAILER_SIZE 16	// Offset of the table & the magic
+// Framed entries start with a zstd skippable frame holding their seek table: frame size, frame
+// count & each frame's compressed size. zstd skips it when decompressing the entry whole.
+#define EX_ACE_SEEK_MAGIC 0x184D2A5E
+#define EX_ACE_SEEK_HEADER_SIZE 16	// Magic, skippable frame size, frame size & frame count
+// Flags stored after the index table; older files have none.
+#define EX_ACE_INDEX_PROFILED 1	// Entries are laid out in first-access order (see SetProfile())
+#define EX_ACE_INDEX_BUNDLES 2	// The bundle table follows the flags (see SetBundles())
+#define EX_ACE_INDEX_CHECKSUMS 4	// The checksum table follows the bundle table, if any (see SetVerify())
+#define EX_ACE_INDEX_SOURCES 8	// The source table follows the checksum table (see AppendContent())
+#define EX_ACE_BUNDLE_BYTES_PER_THREAD (256 * 1024)	// LoadBundle() spreads decompression by output size
+#define EX_ACE_VERIFY_CHUNK (8 * 1024 * 1024)	// Verify() hands records to threads in runs of about this many bytes
+// Small entries packed by SetSolidBlocks() share a record: a table of its members (id, type,
+// offset & size) followed by their data, compressed as one frame. Their index entries all
+// point at it.
+#define EX_ACE_BLOCK_ID "<ace-block>"
+#define EX_ACE_BLOCK_TYPE "blk"
 
 #define FUNCTION_ERROR(msg) msg "\n | Error occured in function " __FUNCTION__
 
@@ -21,23 +52,86 @@ namespace fs = std::filesystem;
 
 static int s_default_level = 0;
 static std::string s_default_path;
+static unsigned int s_frame_size = 0;
+static unsigned int s_readahead = 256 * 1024;
+static unsigned int s_solid_entry_size = 0;
+static unsigned int s_solid_block_size = 64 * 1024;
+static unsigned int s_block_cache = 1024 * 1024;
+static int s_verify = ACE_VERIFY_OFF;
+static std::string s_profile_path;
+static std::string s_bundles_path;
+
+static void* DefaultAlloc(void*, size_t size) { return malloc(size); }
+static void DefaultFree(void*, void* ptr) { free(ptr); }
+static ace_allocator s_allocator = { DefaultAlloc, DefaultFree, NULL };
+
+static void PutU32(std::string& out, uint32_t value) {
+	out.append((const char*)&value, sizeof(uint32_t));
+}
+
+static void PutU64(std::string& out, uint64_t value) {
+	out.append((const char*)&value, sizeof(uint64_t));
+}
+
+static uint32_t GetU32(const unsigned char* in) {
+	uint32_t value;
+	memcpy(&value, in, sizeof(uint32_t));
+	return value;
+}
+
+static uint64_t GetU64(const unsigned char* in) {
+	uint64_t value;
+	memcpy(&value, in, sizeof(uint64_t));
+	return value;
+}
+
+// Entries loaded into an arena start on 16-byte boundaries.
+static size_t ArenaAlign(size_t size) {
+	return (size + 15) & ~(size_t)15;
+}
+
+// Parses a number stored in the file: digits only, up to 'max'; false if it's anything else.
+static bool ParseNumber(const std::string& value, uint64_t max, uint64_t& number) {
+	if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) { return false; }
+	const std::from_chars_result result = std::from_chars(value.data(), value.data() + value.size(), number);
+	return result.ec == std::errc() && number <= max;
+}
+
+static bool ParseNumber(const std::string& value, unsigned int& number) {
+	uint64_t parsed = 0;
+	if (!ParseNumber(value, std::numeric_limits<unsigned int>::max(), parsed)) { return false; }
+	number = (unsigned int)parsed;
+	return true;
+}
+
+// The checksum of a record as stored: its header & data, without the closing delim.
+static uint64_t RecordChecksum(const char* header, size_t header_size, const void* data, size_t size) {
+	XXH64_state_t* state = XXH64_createState();
+	XXH64_reset(state, 0);
+	XXH64_update(state, header, header_size);
+	XXH64_update(state, data, size);
+	const uint64_t checksum = XXH64_digest(state);
+	XXH64_freeState(state);
+	return checksum;
+}
+
+static std::atomic<FILE*> s_log{ stdout };	// NULL when silenced (see SetLog())
 
 static void Log(std::string message) {
-	printf(message.c_str());
-	printf("\n");
+	FILE* log = s_log.load(std::memory_order_relaxed);
+	if (log == NULL) { return; }
+	fprintf(log, message.c_str());
+	fprintf(log, "\n");
 }
 
 template <typename... Values>
 static void Log(std::string message, Values... values) {
-	printf(message.c_str(), values...);
-	printf("\n");
+	FILE* log = s_log.load(std::memory_order_relaxed);
+	if (log == NULL) { return; }
+	fprintf(log, message.c_str(), values...);
+	fprintf(log, "\n");
 }
 
-struct ace_pointer {
-	std::string id;
-	std::streampos pos;
-};
-
 class ace_facet : public std::ctype<char> {
 	mask delim_table[table_size];
 
@@ -48,14 +142,194 @@ public:
 	}
 };
 
-// Singleton
+// One decompression context per thread, so loads only serialize while reading the file.
+struct ace_dctx {
+	ZSTD_DCtx* ctx = ZSTD_createDCtx();
+	~ace_dctx() { ZSTD_freeDCtx(ctx); }
+};
+static thread_local ace_dctx t_dctx;
+// Compressed bytes of the entry being loaded; reused, so loads don't allocate a temporary.
+static thread_local std::vector<char> t_compressed;
+// Whole frames (or entries) a range only needs part of.
+static thread_local std::vector<unsigned char> t_frame;
+
+// A solid block once decompressed; its members are read-only slices of 'data'.
+struct ace_block_member {
+	std::string type;
+	uint32_t offset;
+	uint32_t size;
+};
+struct ace_block {
+	std::vector<unsigned char> data;
+	std::unordered_map<std::string, ace_block_member> members;
+};
+// Set when the entry the last find() found sits in a solid block: its data is copied out of
+// the block rather than decompressed.
+struct ace_solid {
+	std::shared_ptr<const ace_block> block;
+	const ace_block_member* member = nullptr;
+};
+static thread_local ace_solid t_solid;
+
+#ifdef ACE_INSTRUMENT
+// ace_stats, updated from any thread.
+struct ace_counters {
+	std::atomic<uint64_t> lookups{ 0 };
+	std::atomic<uint64_t> misses{ 0 };
+	std::atomic<uint64_t> bytes_read{ 0 };
+	std::atomic<uint64_t> bytes_decompressed{ 0 };
+	std::atomic<uint64_t> io_ns{ 0 };
+	std::atomic<uint64_t> decompress_ns{ 0 };
+	std::atomic<uint64_t> cache_hits{ 0 };
+};
+#endif
+
+struct ace_bundle_member {
+	std::string id;
+	std::streamoff pos;
+	uint64_t size;	// Of the whole record: header, data & delim
+};
+
+// An entry of the index. The checksum is the XXH64 of its record as stored, header & data;
+// records of unknown size (0) aren't checked.
+struct ace_toc_entry {
+	std::string id;
+	uint64_t pos;	// Where its record starts
+	uint64_t checksum;
+	uint64_t size;	// Of the whole record: header, data & delim
+};
+typedef std::vector<ace_toc_entry> ace_toc;
+typedef std::vector<std::pair<std::string, std::vector<std::pair<size_t, uint64_t>>>> ace_bundle_index;	// Names, members' number in the toc & record size
+typedef std::vector<std::pair<std::string, std::string>> ace_sources;	// File names & modification times, in directory order
+
+// The bundle table: its size, then each bundle's name & members; a member is the number of its
+// entry in the index & the size of its record.
+static bool ReadBundleTable(const unsigned char*& it, const unsigned char* end, size_t toc_size, ace_bundle_index& bundles) {
+	if (end - it < 4) { return false; }
+	const uint32_t count = GetU32(it);
+	it += 4;
+	for (uint32_t i = 0; i < count; i++) {
+		if (end - it < 4 || (size_t)(end - it) < 4 + GetU32(it) + 4) { return false; }
+		const uint32_t name_size = GetU32(it);
+		bundles.emplace_back(std::string((const char*)it + 4, name_size), std::vector<std::pair<size_t, uint64_t>>());
+		it += 4 + name_size;
+		const uint32_t member_count = GetU32(it);
+		it += 4;
+		if ((size_t)(end - it) < member_count * (size_t)12) { return false; }
+		for (uint32_t m = 0; m < member_count; m++, it += 12) {
+			const uint32_t entry = GetU32(it);
+			if (entry >= toc_size) { return false; }
+			bundles.back().second.emplace_back(entry, GetU64(it + 4));
+		}
+	}
+	return true;
+}
+
+// The source table: its size, then each file's name & modification time.
+static bool ReadSourceTable(const unsigned char*& it, const unsigned char* end, ace_sources& sources) {
+	if (end - it < 4) { return false; }
+	const uint32_t count = GetU32(it);
+	it += 4;
+	if (count > (size_t)(end - it) / 8) { return false; }
+	for (uint32_t i = 0; i < count; i++) {
+		std::string values[2];
+		for (auto& value : values) {
+			if (end - it < 4 || (size_t)(end - it) - 4 < GetU32(it)) { return false; }
+			value.assign((const char*)it + 4, GetU32(it));
+			it += 4 + value.size();
+		}
+		sources.emplace_back(std::move(values[0]), std::move(values[1]));
+	}
+	return true;
+}
+
+// Reads the index record that closes a file (see WriteIndex()): entries in table order, flags,
+// bundles & sources, when asked for; false if there's none or its entry table is damaged. A
+// damaged bundle or source table only leaves it empty.
+static bool ReadIndex(std::istream& in, ace_toc& toc, uint32_t& flags, ace_bundle_index& bundles, ace_sources* sources = nullptr) {
+	in.clear();
+	in.seekg(0, std::ios::end);
+	const std::streamoff file_size = in.tellg();
+	unsigned char trailer[EX_ACE_TRAILER_SIZE + 1];	// Trailer & the record's closing delim
+	if (file_size < (std::streamoff)sizeof(trailer)) { return false; }
+	in.seekg(file_size - (std::streamoff)sizeof(trailer));
+	in.read((char*)trailer, sizeof(trailer));
+	if (!in || trailer[EX_ACE_TRAILER_SIZE] != EX_ACE_DELIM ||
+		memcmp(trailer + 8, EX_ACE_INDEX_MAGIC, 8) != 0) {
+		return false;
+	}
+
+	const uint64_t table_pos = GetU64(trailer);
+	if (table_pos >= (uint64_t)file_size) { return false; }
+	std::vector<char> table((size_t)(file_size - (std::streamoff)sizeof(trailer) - table_pos));
+	in.seekg((std::streamoff)table_pos);
+	in.read(table.data(), table.size());
+	if (!in || table.size() < 4) { return false; }
+
+	const unsigned char* it = (const unsigned char*)table.data();
+	const unsigned char* end = it + table.size();
+	const uint32_t count = GetU32(it);
+	it += 4;
+	// Each entry takes at least 12 bytes (id size & position), so a damaged count is caught
+	// before anything is allocated for it.
+	if (count > (size_t)(end - it) / 12) { return false; }
+	toc.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		if (end - it < 4 || (size_t)(end - it) < 4 + GetU32(it) + 8) {
+			toc.clear();
+			return false;
+		}
+		const uint32_t id_size = GetU32(it);
+		toc.push_back({ std::string((const char*)it + 4, id_size), GetU64(it + 4 + id_size), 0, 0 });
+		it += 4 + id_size + 8;
+	}
+	flags = 0;
+	if (end - it >= 4) {
+		flags = GetU32(it);
+		it += 4;
+	}
+	if ((flags & EX_ACE_INDEX_BUNDLES) != 0 && !ReadBundleTable(it, end, toc.size(), bundles)) {
+		Log(FUNCTION_ERROR("ERROR: ACE: The bundle table is damaged; bundles won't load."));
+		bundles.clear();
+		flags &= ~EX_ACE_INDEX_CHECKSUMS;	// Can't be found past it
+	}
+	// The checksum table: each entry's checksum & record size, in table order.
+	if ((flags & EX_ACE_INDEX_CHECKSUMS) != 0 && (size_t)(end - it) < toc.size() * (size_t)16) { flags &= ~EX_ACE_INDEX_CHECKSUMS; }
+	if ((flags & EX_ACE_INDEX_CHECKSUMS) != 0) {
+		for (auto& entry : toc) {
+			entry.checksum = GetU64(it);
+			entry.size = GetU64(it + 8);
+			it += 16;
+		}
+	}
+	else { flags &= ~EX_ACE_INDEX_SOURCES; }	// Can't be found past it
+	if (sources != nullptr && (flags & EX_ACE_INDEX_SOURCES) != 0 && !ReadSourceTable(it, end, *sources)) {
+		sources->clear();
+		flags &= ~EX_ACE_INDEX_SOURCES;
+	}
+	return true;
+}
+
+// One archive: its stream, dictionary & an index of where each entry starts.
 class ace_iterator {
-	std::vector<ace_pointer> visited_;
+	std::unordered_map<std::string, std::streampos> index_;	// Filled once by Prime(); read-only afterwards
+	std::unordered_map<std::string, std::vector<ace_bundle_member>> bundles_;	// Same as 'index_'
 	std::fstream stream_;
 	std::streampos pos_;
-	ZSTD_DCtx* dctx_;
-	ZSTD_DDict* ddict_;
+	ZSTD_DDict* ddict_;	// Read-only once created; shared by every thread
+	std::mutex mutex_;	// Guards the stream & the readahead window
 	bool is_valid_;
+	bool profiled_ = false;	// Laid out in first-access order, so entries are read ahead
+	std::vector<char> ahead_;	// Readahead window: file bytes from 'ahead_pos_' on
+	std::streamoff ahead_pos_ = 0;
+	std::streamoff next_pos_ = 0;	// Where the entry after the last one read starts
+	std::list<std::pair<std::streamoff, std::shared_ptr<const ace_block>>> blocks_;	// Solid blocks by position, most recently used first
+	size_t blocks_bytes_ = 0;	// Decompressed size of 'blocks_'; guarded by 'mutex_' as well
+	std::unordered_map<std::streamoff, std::pair<uint64_t, uint64_t>> checksums_;	// Checksum & size of each record, by position; same as 'index_'
+	std::unordered_set<std::streamoff> verified_;	// Records whose checksum matched; guarded by 'mutex_'
+#ifdef ACE_INSTRUMENT
+	mutable ace_counters stats_;
+#endif
 
 	void seek_pos(std::streampos pos) {
 		stream_.clear();
@@ -63,43 +337,12 @@ class ace_iterator {
 		pos_ = std::move(pos);
 	}
 
-	ace_pointer query_pointer() {
-		std::streampos init_pos = pos_;
-		ace_pointer vi{ std::move(parse_value()), std::move(init_pos) };
-		seek_pos(init_pos);	// return to initial pos
-		return vi;
-	}
-
-	void store_pointer(ace_pointer& ptr) {
-		if (std::find_if(visited_.begin(), visited_.end(),
-			[&](ace_pointer& val) {
-				return ptr.id == val.id;
-			}
-		) == visited_.end()) {
-			visited_.push_back(std::move(ptr));
+	static void strip_quotes(std::string& buffer) {
+		if (*(buffer.begin()) == '"') {
+			if (*(buffer.rbegin()) == '"') { buffer = buffer.substr(1, buffer.length() - 2); }
+			else { buffer = buffer.substr(1, buffer.length() - 1); }
 		}
-	}
-
-	void skip_value(size_t count = NULL) {
-		if (count == NULL) { stream_.ignore(EX_ACE_STREAMSIZE_MAX, EX_ACE_DELIM); }
-		else {
-			for (size_t i = 0; i < count; i++) {
-				stream_.ignore();
-			}
-			if (stream_.peek() == EX_ACE_DELIM) {
-				stream_.ignore();	// skip delim
-			}
-		}
-		pos_ = std::move(stream_.tellg());
-	}
-
-	void skip_entry() {
-		auto pointer = query_pointer();
-		store_pointer(pointer);
-		skip_value();	// name
-		skip_value();	// ext
-		skip_value();	// uncompressed size
-		skip_value(std::stoll(parse_value()));	// compressed size && data
+		else if (*(buffer.rbegin()) == '"') { buffer = buffer.substr(0, buffer.length() - 1); }
 	}
 
 	std::string parse_value() {
@@ -109,16 +352,91 @@ class ace_iterator {
 			if (stream_.peek() == EX_ACE_DELIM) {
 				stream_.ignore();	// skip delim
 			}
-			if (*(buffer.begin()) == '"') {
-				if (*(buffer.rbegin()) == '"') { buffer = buffer.substr(1, buffer.length() - 2); }
-				else { buffer = buffer.substr(1, buffer.length() - 1); }
-			}
-			else if (*(buffer.rbegin()) == '"') { buffer = buffer.substr(0, buffer.length() - 1); }
+			strip_quotes(buffer);
 			pos_ = std::move(stream_.tellg());
 		}
 		return buffer;
 	}
 
+	// parse_value() on file bytes already in memory, from 'at' on; false if the value may go on
+	// past 'size'.
+	static bool parse_memory_value(const char* data, size_t size, size_t& at, std::string& buffer) {
+		auto is_delim = [](char c) { return c == EX_ACE_DELIM || isspace((unsigned char)c); };
+		while (at < size && is_delim(data[at])) { at++; }
+		const size_t start = at;
+		while (at < size && !is_delim(data[at])) { at++; }
+		if (at >= size || at == start) { return false; }
+		buffer.assign(data + start, at - start);
+		if (data[at] == EX_ACE_DELIM) { at++; }	// skip delim
+		strip_quotes(buffer);
+		return true;
+	}
+
+	// parse_entry() on file bytes already in memory, without the data; 'at' is left at the data.
+	static bool parse_memory_header(const char* data, size_t size, size_t& at, EX_ace_entry_cpp& entry, unsigned int& compressed_size) {
+		std::string entry_size, compressed;
+		if (!parse_memory_value(data, size, at, entry.id) || !parse_memory_value(data, size, at, entry.type) ||
+			!parse_memory_value(data, size, at, entry_size) || !parse_memory_value(data, size, at, compressed)) {
+			return false;
+		}
+		return ParseNumber(entry_size, entry.size) && ParseNumber(compressed, compressed_size);
+	}
+
+	// Header of the entry at 'pos', if it's entirely inside the readahead window; 'at' is left
+	// at the entry's data.
+	bool parse_ahead_header(std::streamoff pos, size_t& at, EX_ace_entry_cpp& entry, unsigned int& compressed_size) const {
+		if (pos < ahead_pos_ || pos >= ahead_pos_ + (std::streamoff)ahead_.size()) { return false; }
+		at = (size_t)(pos - ahead_pos_);
+		return parse_memory_header(ahead_.data(), ahead_.size(), at, entry, compressed_size);
+	}
+
+	// parse_entry() through the readahead window: profiled files store entries in the order
+	// they're loaded, so one read usually brings in the next few. Once loads go through entries
+	// in file order, the window is refilled from the entry's header on whenever it isn't in the
+	// window; other loads read their entry alone. Data past the window comes from the stream.
+	EX_ace_entry_cpp read_ahead(std::streamoff pos, unsigned int& compressed_size, bool read_data) {
+		EX_ace_entry_cpp entry;
+		size_t at = 0;
+		const bool hit = parse_ahead_header(pos, at, entry, compressed_size);
+		if (!hit && pos == next_pos_) {
+			ahead_.resize(s_readahead);
+			seek_pos(pos);
+			stream_.read(ahead_.data(), ahead_.size());
+			ahead_.resize((size_t)stream_.gcount());
+			ahead_pos_ = pos;
+			ACE_STAT_ADD(stats_.bytes_read, ahead_.size());
+		}
+		if (!hit && !parse_ahead_header(pos, at, entry, compressed_size)) {
+			seek_pos(pos);
+			entry = parse_entry(compressed_size, false);
+			if (entry.id == "") { return entry; }
+			next_pos_ = (std::streamoff)pos_ + compressed_size + 1;	// Data & delim
+			if (read_data) {
+				parse_bytes(t_compressed, compressed_size);
+				ACE_STAT_ADD(stats_.bytes_read, compressed_size);
+			}
+			return entry;
+		}
+
+		const std::streamoff data_pos = ahead_pos_ + (std::streamoff)at;
+		next_pos_ = data_pos + compressed_size + 1;
+		if (!read_data) {
+			seek_pos(data_pos);
+			if (hit) { ACE_STAT_ADD(stats_.cache_hits, 1); }
+			return entry;
+		}
+		const size_t in_window = std::min((size_t)compressed_size, ahead_.size() - at);
+		t_compressed.resize(compressed_size);
+		memcpy(t_compressed.data(), ahead_.data() + at, in_window);
+		if (in_window < compressed_size) {
+			seek_pos(data_pos + (std::streamoff)in_window);
+			stream_.read(t_compressed.data() + in_window, compressed_size - in_window);
+			ACE_STAT_ADD(stats_.bytes_read, compressed_size - in_window);
+		}
+		else if (hit) { ACE_STAT_ADD(stats_.cache_hits, 1); }
+		return entry;
+	}
+
 	char* parse_bytes(unsigned int bytes) {
 		char* read_buf = (char*)malloc(bytes);
 		stream_.read(read_buf, bytes);
@@ -129,174 +447,1200 @@ class ace_iterator {
 		return read_buf;
 	}
 
-	unsigned char* parse_bytes(unsigned int bytes, unsigned int out_bytes) {
-		char* read_buf = parse_bytes(bytes);
-		unsigned char* out_buf = (unsigned char*)malloc(out_bytes);
-		ZSTD_decompress_usingDDict(dctx_, out_buf, out_bytes, read_buf, bytes, ddict_);
-		free(read_buf);
-		return out_buf;
-	}
-
-	ace_entry parse_entry() {
-		ace_entry entry = {};
-		if (!is_valid_) { 
-			Log(FUNCTION_ERROR("ERROR: ACE: Not a .ace file! Seeking failed."));
-			return entry;
+	void parse_bytes(std::vector<char>& buffer, unsigned int bytes) {
+		buffer.resize(bytes);
+		stream_.read(buffer.data(), bytes);
+		if (stream_.peek() == EX_ACE_DELIM) {
+			stream_.ignore();	// skip delim
 		}
+		pos_ = std::move(stream_.tellg());
+	}
 
-		ace_pointer ptr = query_pointer();
-		store_pointer(ptr);
+	// Reads the entry at the current position; its compressed data goes to 't_compressed'.
+	// Without 'read_data' only the header is parsed. A damaged header gives an empty entry.
+	EX_ace_entry_cpp parse_entry(unsigned int& compressed_size, bool read_data = true) {
+		EX_ace_entry_cpp entry;
 		entry.id = std::move(parse_value());
 		entry.type = std::move(parse_value());
-		entry.size = (unsigned int)std::stoi(std::move(parse_value()));
-		const int compressed_size = std::stoi(std::move(parse_value()));
-		entry.data = parse_bytes(compressed_size, entry.size);
-		return std::move(entry);
+		if (!ParseNumber(parse_value(), entry.size) || !ParseNumber(parse_value(), compressed_size)) {
+			compressed_size = 0;
+			return {};
+		}
+		if (read_data) { parse_bytes(t_compressed, compressed_size); }
+		return entry;
+	}
+
+	size_t decompress(void* dst, unsigned int capacity, const void* src, size_t compressed_size) {
+		ACE_TRACE_SCOPE("ace", "decompress", nullptr);
+		ACE_STAT_TIME(stats_.decompress_ns);
+		const size_t written = ZSTD_decompress_usingDDict(t_dctx.ctx, dst, capacity, src, compressed_size, ddict_);
+		if (ZSTD_isError(written)) { return 0; }
+		ACE_STAT_ADD(stats_.bytes_decompressed, written);
+		return written;
+	}
+
+	// Decompresses only the first 'size' bytes of an entry; zstd stops as soon as they're out,
+	// so reading a header doesn't cost the whole entry.
+	size_t decompress_prefix(void* dst, size_t size, const void* src, size_t compressed_size) {
+		ACE_TRACE_SCOPE("ace", "decompress", nullptr);
+		ACE_STAT_TIME(stats_.decompress_ns);
+		ZSTD_DCtx* ctx = t_dctx.ctx;
+		ZSTD_DCtx_reset(ctx, ZSTD_reset_session_and_parameters);
+		ZSTD_DCtx_refDDict(ctx, ddict_);
+		ZSTD_outBuffer out = { dst, size, 0 };
+		ZSTD_inBuffer in = { src, compressed_size, 0 };
+		while (out.pos < out.size) {
+			const size_t in_pos = in.pos, out_pos = out.pos;
+			const size_t result = ZSTD_decompressStream(ctx, &out, &in);
+			if (ZSTD_isError(result)) {
+				out.pos = 0;
+				break;
+			}
+			if (result == 0 || (in.pos == in_pos && out.pos == out_pos)) { break; }	// Done, or no progress
+		}
+		ZSTD_DCtx_reset(ctx, ZSTD_reset_session_and_parameters);	// Back to one-shot use
+		ACE_STAT_ADD(stats_.bytes_decompressed, out.pos);
+		return out.pos;
+	}
+
+	// Decompresses what the last find() read; members of solid blocks are copied out of theirs.
+	size_t decompress(void* dst, unsigned int capacity, unsigned int compressed_size) {
+		if (t_solid.block != nullptr) {
+			const uint32_t size = t_solid.member->size;
+			if (size > capacity) { return 0; }
+			memcpy(dst, t_solid.block->data.data() + t_solid.member->offset, size);
+			t_solid = {};	// Don't keep the block alive
+			return size;
+		}
+		return decompress(dst, capacity, t_compressed.data(), compressed_size);
+	}
+
+	// The cached solid block at 'pos', made the most recently used; NULL if it isn't cached.
+	std::shared_ptr<const ace_block> cached_block(std::streamoff pos) {
+		for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+			if (it->first != pos) { continue; }
+			blocks_.splice(blocks_.begin(), blocks_, it);
+			return blocks_.front().second;
+		}
+		return nullptr;
+	}
+
+	// Decompresses the solid block at 'pos', whose data the last find() read, & caches it; the
+	// least recently used blocks make room for it. NULL if it's damaged.
+	std::shared_ptr<const ace_block> load_block(std::streamoff pos, unsigned int size, unsigned int compressed_size) {
+		std::shared_ptr<ace_block> block = std::make_shared<ace_block>();
+		block->data.resize(size);
+		if (size < 4 || decompress(block->data.data(), size, t_compressed.data(), compressed_size) != size) { return nullptr; }
+		const unsigned char* it = block->data.data();
+		const unsigned char* end = it + size;
+		const uint32_t count = GetU32(it);
+		it += 4;
+		for (uint32_t i = 0; i < count; i++) {
+			if (end - it < 4 || (size_t)(end - it) < 4 + GetU32(it) + 4) { return nullptr; }
+			const uint32_t id_size = GetU32(it);
+			std::string id((const char*)it + 4, id_size);
+			it += 4 + id_size;
+			const uint32_t type_size = GetU32(it);
+			if ((size_t)(end - it) < 4 + type_size + 8) { return nullptr; }
+			ace_block_member member{ std::string((const char*)it + 4, type_size), GetU32(it + 4 + type_size), GetU32(it + 8 + type_size) };
+			it += 4 + type_size + 8;
+			if ((uint64_t)member.offset + member.size > size) { return nullptr; }
+			block->members.emplace(std::move(id), std::move(member));
+		}
+
+		blocks_.emplace_front(pos, block);
+		blocks_bytes_ += size;
+		while (!blocks_.empty() && blocks_bytes_ > s_block_cache) {
+			blocks_bytes_ -= blocks_.back().second->data.size();
+			blocks_.pop_back();
+		}
+		return block;
 	}
 
-	ace_iterator() : is_valid_(false), pos_(0), dctx_(NULL), ddict_(NULL) {};
+	// A member of a solid block, the way find() returns entries; its data is left in 't_solid'.
+	EX_ace_entry_cpp solid_member(std::shared_ptr<const ace_block> block, const char* entry_id, unsigned int& compressed_size) {
+		auto member = block->members.find(entry_id);
+		if (member == block->members.end()) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is missing from its solid block."), entry_id);
+			return {};
+		}
+		EX_ace_entry_cpp entry;
+		entry.id = entry_id;
+		entry.type = member->second.type;
+		entry.size = member->second.size;
+		compressed_size = entry.size;	// Stored as is inside the block
+		t_solid = { std::move(block), &member->second };
+		return entry;
+	}
+
+	// Reads the seek table of the entry whose data starts at the current position; false if it
+	// isn't framed, or if the table doesn't match the entry ('entry_size' bytes, 'compressed_size'
+	// stored), which sets 'damaged'. 'frame_sizes' gets each frame's compressed size.
+	bool parse_seek_table(unsigned int entry_size, unsigned int compressed_size, unsigned int& frame_size,
+		std::vector<uint32_t>& frame_sizes, bool& damaged) {
+		damaged = false;
+		unsigned char header[EX_ACE_SEEK_HEADER_SIZE];
+		if (compressed_size < sizeof(header)) { return false; }
+		stream_.read((char*)header, sizeof(header));
+		if (!stream_ || GetU32(header) != EX_ACE_SEEK_MAGIC) { return false; }
+		damaged = true;
+		frame_size = GetU32(header + 8);
+		const uint64_t frame_count = GetU32(header + 12);
+		const uint64_t table_size = sizeof(header) + frame_count * sizeof(uint32_t);
+		if (frame_size == 0 || GetU32(header + 4) != table_size - 8 || table_size > compressed_size ||
+			frame_count != ((uint64_t)entry_size + frame_size - 1) / frame_size) {
+			return false;
+		}
+		frame_sizes.resize((size_t)frame_count);
+		stream_.read((char*)frame_sizes.data(), frame_count * sizeof(uint32_t));
+		if (!stream_) { return false; }
+		uint64_t frames_size = 0;
+		for (uint32_t size : frame_sizes) { frames_size += size; }
+		if (frames_size != compressed_size - table_size) { return false; }
+		damaged = false;
+		return true;
+	}
+
+	// Loads the index written by Generate() at the end of the file; false if there's none.
+	bool read_index() {
+		ace_toc toc;
+		uint32_t flags = 0;
+		ace_bundle_index bundles;
+		if (!ReadIndex(stream_, toc, flags, bundles)) { return false; }
+		index_.reserve(toc.size());
+		for (auto& entry : toc) {
+			index_.emplace(entry.id, (std::streamoff)entry.pos);
+			if (entry.size != 0) { checksums_.emplace((std::streamoff)entry.pos, std::make_pair(entry.checksum, entry.size)); }
+		}
+		profiled_ = (flags & EX_ACE_INDEX_PROFILED) != 0;
+		for (auto& bundle : bundles) {
+			std::vector<ace_bundle_member>& members = bundles_[bundle.first];
+			for (auto& member : bundle.second) {
+				members.push_back({ toc[member.first].id, (std::streamoff)toc[member.first].pos, member.second });
+			}
+		}
+		return true;
+	}
+
+	// The first time a record's data is read, checks it against the index (see SetVerify()):
+	// its header is read again & hashed along with 'data'. false if it doesn't match, the
+	// header included. Callers hold 'mutex_'; the stream is left past the header.
+	bool verify(std::streamoff pos, const void* data, size_t size) {
+		if (s_verify != ACE_VERIFY_FIRST_LOAD || verified_.count(pos) != 0) { return true; }
+		auto checksum = checksums_.find(pos);
+		if (checksum == checksums_.end()) { return true; }	// Older files have nothing to check
+		const uint64_t record_size = checksum->second.second;
+		if (record_size < size + 1) { return false; }
+		std::vector<char> header((size_t)(record_size - size - 1));
+		seek_pos(pos);
+		stream_.read(header.data(), header.size());
+		if (!stream_) { return false; }
+		ACE_STAT_ADD(stats_.bytes_read, header.size());
+		if (RecordChecksum(header.data(), header.size(), data, size) != checksum->second.first) { return false; }
+		verified_.insert(pos);
+		return true;
+	}
+
+	// Older files have no index: walks every entry header once, seeking over the data.
+	void scan_index(std::streampos data_pos) {
+		seek_pos(data_pos);
+		while (true) {
+			const std::streampos entry_pos = pos_;
+			std::string id = parse_value();
+			if (id.size() == 0 || id == EX_ACE_INDEX_ID) { break; }
+			parse_value();	// ext
+			parse_value();	// uncompressed size
+			uint64_t compressed_size = 0;
+			if (!ParseNumber(parse_value(), EX_ACE_STREAMSIZE_MAX, compressed_size)) { break; }
+			index_.emplace(std::move(id), entry_pos);
+			stream_.seekg((std::streamoff)compressed_size, std::ios::cur);
+			if (stream_.peek() == EX_ACE_DELIM) {
+				stream_.ignore();	// skip delim
+			}
+			pos_ = std::move(stream_.tellg());
+		}
+	}
 
 public:
+	ace_iterator() : is_valid_(false), pos_(0), ddict_(NULL) {};
 	ace_iterator(ace_iterator const&) = delete;             // Copy construct
 	ace_iterator(ace_iterator&&) = delete;                  // Move construct
 	ace_iterator& operator=(ace_iterator const&) = delete;  // Copy assign
 	ace_iterator& operator=(ace_iterator&&) = delete;
 
-	static ace_iterator& Get() {
-		static ace_iterator it;
-		return it;
+	ace_iterator* Prime(const std::string& path) {
+		Log("LOG: ACE: Primed file information:");
+		
+		stream_.open(path, std::ios::in | std::ios::binary);
+		if (!stream_) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not open ace file! (%s)"), path.c_str());
+			return NULL;
+		}
+
+		Log(" | Path: %s", path.c_str());
+
+		std::locale x(std::locale::classic(), new ace_facet);	// does this leak?
+		stream_.imbue(x);
+		stream_.clear();
+		stream_.seekg(0, std::ios::beg);	// Seek the beggining just in case
+		
+		uint64_t magicNumber = 0;
+		ParseNumber(parse_value(), std::numeric_limits<int>::max(), magicNumber);
+
+		Log(" | Magic #: %d", (int)magicNumber);
+
+		is_valid_ = magicNumber == 0xACE ? true : false;
+
+		Log(" | Valid: %s", is_valid_ ? "true" : "false");
+		
+		if (!is_valid_) {
+			return NULL;
+		}
+
+		char* buffer = parse_bytes(16);
+		std::string hash;
+		char digits[4];
+		for (int i = 0; i < 16; i++) {
+			unsigned char x = (unsigned char)buffer[i];
+			if (x <= 0xF) {
+				snprintf(digits, sizeof(digits), "0%d", x);
+			}
+			else {
+				snprintf(digits, sizeof(digits), "%1X", x);
+			}
+			hash += digits;
+		}
+		Log(" | Hash: 0x%s", hash.c_str());
+		free(buffer);
+
+		uint64_t dict_size = 0;
+		if (!ParseNumber(parse_value(), std::numeric_limits<int>::max(), dict_size)) {
+			Log(FUNCTION_ERROR("ERROR: ACE: The ace file's dictionary is damaged!"));
+			is_valid_ = false;
+			return NULL;
+		}
+		
+		Log(" | Dict. size: %d", (int)dict_size);
+
+		char* dict = (char*)malloc(dict_size * sizeof(char));
+		stream_.read((char*)dict, dict_size);
+		if (stream_.peek() == EX_ACE_DELIM) {
+			stream_.ignore();	// skip delim
+		}
+		pos_ = std::move(stream_.tellg());
+		ddict_ = ZSTD_createDDict(dict, dict_size);
+		free(dict);
+
+		const std::streampos data_pos = pos_;
+		next_pos_ = data_pos;	// Loads starting with the first entry are read ahead
+		const bool indexed = read_index();
+		if (!indexed) { scan_index(data_pos); }
+		Log(" | Entries: %d (%s%s)", (int)index_.size(), indexed ? "indexed" : "scanned", profiled_ ? ", profiled" : "");
+
+		return this;
+	}
+
+	bool has_bundle(const char* name) const {
+		return bundles_.find(name) != bundles_.end();
+	}
+
+	// Loads a whole bundle into one arena, like LoadArena(): its records are read at once (one
+	// read per contiguous run), then decompressed in parallel. Safe to call from several
+	// threads at once.
+	unsigned char* load_bundle(const char* name, std::vector<EX_ace_entry_cpp>& entries,
+		std::vector<size_t>& offsets, bool with_strings, unsigned char*& strings) {
+		auto bundle = bundles_.find(name);
+		if (bundle == bundles_.end()) { return nullptr; }
+		const std::vector<ace_bundle_member>& members = bundle->second;
+
+		// Runs of records that follow each other in the file; 'at[i]' is where member i lands.
+		std::vector<size_t> order(members.size());
+		for (size_t i = 0; i < order.size(); i++) { order[i] = i; }
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return members[a].pos < members[b].pos; });
+		std::vector<std::pair<std::streamoff, uint64_t>> runs;	// File position & size
+		std::vector<size_t> at(members.size());
+		size_t blob_size = 0;
+		for (size_t i : order) {
+			const ace_bundle_member& member = members[i];
+			if (runs.empty() || runs.back().first + (std::streamoff)runs.back().second != member.pos) {
+				runs.emplace_back(member.pos, 0);
+			}
+			at[i] = blob_size;
+			runs.back().second += member.size;
+			blob_size += (size_t)member.size;
+		}
+
+		std::vector<char> blob(blob_size);
+		{
+			ACE_TRACE_SCOPE("ace", "read", name);
+			ACE_STAT_TIME(stats_.io_ns);
+			std::lock_guard<std::mutex> lock(mutex_);
+			char* dst = blob.data();
+			for (auto& run : runs) {
+				seek_pos(run.first);
+				stream_.read(dst, (std::streamsize)run.second);
+				if (!stream_) {
+					Log(FUNCTION_ERROR("ERROR: ACE: Could not read bundle \"%s\"."), name);
+					return nullptr;
+				}
+				dst += run.second;
+			}
+			ACE_STAT_ADD(stats_.bytes_read, blob_size);
+		}
+
+		std::vector<EX_ace_entry_cpp> headers(members.size());
+		std::vector<unsigned int> compressed_sizes(members.size());
+		const std::vector<size_t> record_at = at;	// 'at' moves on to each member's data
+		size_t data_bytes = 0, string_bytes = 0;
+		for (size_t i = 0; i < members.size(); i++) {
+			const size_t end = at[i] + (size_t)members[i].size;
+			if (!parse_memory_header(blob.data(), end, at[i], headers[i], compressed_sizes[i]) || at[i] + compressed_sizes[i] > end) {
+				Log(FUNCTION_ERROR("ERROR: ACE: Bundle \"%s\" has a damaged entry (\"%s\")."), name, members[i].id.c_str());
+				return nullptr;
+			}
+			data_bytes += ArenaAlign(headers[i].size);
+			if (with_strings) { string_bytes += headers[i].id.size() + headers[i].type.size() + 2; }
+		}
+
+		unsigned char* arena = (unsigned char*)ace::Alloc(data_bytes + string_bytes + 1);
+		if (arena == nullptr) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not allocate an arena of %llu bytes."), (unsigned long long)(data_bytes + string_bytes));
+			return nullptr;
+		}
+		std::vector<size_t> arena_offsets(members.size());
+		for (size_t i = 0, offset = 0; i < members.size(); i++) {
+			arena_offsets[i] = offset;
+			offset += ArenaAlign(headers[i].size);
+		}
+
+		// Members read for the first time are checked along the way (see SetVerify()).
+		std::vector<const uint64_t*> checksums(members.size(), nullptr);	// Of the whole record
+		if (s_verify == ACE_VERIFY_FIRST_LOAD) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < members.size(); i++) {
+				auto checksum = checksums_.find(members[i].pos);
+				if (checksum != checksums_.end() && verified_.count(members[i].pos) == 0) { checksums[i] = &checksum->second.first; }
+			}
+		}
+
+		// Members go to whichever thread is free; each has its own decompression context.
+		std::vector<char> decompressed(members.size(), 0);
+		std::vector<char> corrupt(members.size(), 0);
+		std::atomic<size_t> next_member(0);
+		auto worker = [&]() {
+			for (size_t i; (i = next_member++) < members.size();) {
+				if (checksums[i] != nullptr && XXH64(blob.data() + record_at[i], (size_t)members[i].size - 1, 0) != *checksums[i]) {
+					corrupt[i] = 1;
+					continue;
+				}
+				decompressed[i] = decompress(arena + arena_offsets[i], headers[i].size, blob.data() + at[i], compressed_sizes[i]) == headers[i].size;
+			}
+		};
+		int threads = (int)std::min<size_t>(std::thread::hardware_concurrency(), data_bytes / EX_ACE_BUNDLE_BYTES_PER_THREAD);
+		threads = std::max(1, std::min(threads, (int)members.size()));
+		std::vector<std::thread> pool;
+		for (int t = 1; t < threads; t++) { pool.emplace_back(worker); }
+		worker();
+		for (auto& thread : pool) { thread.join(); }
+		if (s_verify == ACE_VERIFY_FIRST_LOAD) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (size_t i = 0; i < members.size(); i++) {
+				if (checksums[i] != nullptr && !corrupt[i]) { verified_.insert(members[i].pos); }
+			}
+		}
+
+		entries.reserve(members.size());
+		offsets.reserve(members.size());
+		for (size_t i = 0; i < members.size(); i++) {
+			if (corrupt[i]) {
+				Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is corrupt; its checksum doesn't match."), members[i].id.c_str());
+				continue;
+			}
+			if (!decompressed[i]) {
+				Log(FUNCTION_ERROR("ERROR: ACE: Could not decompress entry \"%s\"."), members[i].id.c_str());
+				continue;
+			}
+			offsets.push_back(arena_offsets[i]);
+			entries.push_back(std::move(headers[i]));
+		}
+		strings = arena + data_bytes;
+		return arena;
+	}
+
+	bool contains(const char* entry_id) const {
+		const bool found = index_.find(entry_id) != index_.end();
+		ACE_STAT_ADD(stats_.lookups, 1);
+		if (!found) { ACE_STAT_ADD(stats_.misses, 1); }
+		return found;
+	}
+
+#ifdef ACE_INSTRUMENT
+	// Adds this archive's counters to 'stats'.
+	void add_stats(ace_stats& stats) const {
+		stats.lookups += stats_.lookups;
+		stats.misses += stats_.misses;
+		stats.bytes_read += stats_.bytes_read;
+		stats.bytes_decompressed += stats_.bytes_decompressed;
+		stats.io_ns += stats_.io_ns;
+		stats.decompress_ns += stats_.decompress_ns;
+		stats.cache_hits += stats_.cache_hits;
+	}
+
+	void reset_stats() {
+		stats_.lookups = 0;
+		stats_.misses = 0;
+		stats_.bytes_read = 0;
+		stats_.bytes_decompressed = 0;
+		stats_.io_ns = 0;
+		stats_.decompress_ns = 0;
+		stats_.cache_hits = 0;
+	}
+#endif
+
+	// Safe to call from several threads at once.
+	EX_ace_entry_cpp operator[](const char* entry_id) {
+		unsigned int compressed_size = 0;
+		EX_ace_entry_cpp entry = find(entry_id, compressed_size);
+		if (entry.id == "") { return entry; }
+		entry.data = (unsigned char*)ace::Alloc(entry.size);
+		if (entry.data == nullptr || decompress(entry.data, entry.size, compressed_size) != entry.size) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not decompress entry \"%s\"."), entry_id);
+			entry.Dispose();
+			return {};
+		}
+		return entry;
+	}
+
+	// Header of an entry (id, type & decompressed size) without reading its data.
+	EX_ace_entry_cpp peek(const char* entry_id) {
+		unsigned int compressed_size = 0;
+		return find(entry_id, compressed_size, false);
+	}
+
+	// Decompresses an entry straight into 'dst'; returns the bytes written, or 0.
+	unsigned int load_into(const char* entry_id, void* dst, unsigned int capacity) {
+		unsigned int compressed_size = 0;
+		EX_ace_entry_cpp entry = find(entry_id, compressed_size);
+		if (entry.id == "" || entry.size > capacity) { return 0; }
+		return (unsigned int)decompress(dst, capacity, compressed_size);
+	}
+
+	// Decompresses 'length' bytes from 'offset' on; returns the bytes written, or 0.
+	unsigned int read_range(const char* entry_id, unsigned int offset, unsigned int length, unsigned char* dst) {
+		unsigned int compressed_size = 0;
+		unsigned int frame_size = 0;
+		std::vector<uint32_t> frame_sizes;
+		EX_ace_entry_cpp entry;
+		size_t first = 0, last = 0;	// Frames the range touches
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			entry = find_locked(entry_id, compressed_size, false);
+			if (entry.id == "" || offset >= entry.size || length == 0) { return 0; }
+			length = std::min(length, entry.size - offset);
+			if (t_solid.block != nullptr) {	// Already decompressed along with its block
+				memcpy(dst, t_solid.block->data.data() + t_solid.member->offset + offset, length);
+				t_solid = {};
+				return length;
+			}
+			ACE_TRACE_SCOPE("ace", "read", entry_id);
+			ACE_STAT_TIME(stats_.io_ns);
+			const std::streampos data_pos = stream_.tellg();
+			bool damaged = false;
+			if (parse_seek_table(entry.size, compressed_size, frame_size, frame_sizes, damaged)) {
+				first = offset / frame_size;
+				last = (offset + length - 1) / frame_size;
+				if (last >= frame_sizes.size()) { return 0; }
+				uint64_t skip = 0, bytes = 0;
+				for (size_t i = 0; i < first; i++) { skip += frame_sizes[i]; }
+				for (size_t i = first; i <= last; i++) { bytes += frame_sizes[i]; }
+				stream_.seekg(skip, std::ios::cur);
+				t_compressed.resize((size_t)bytes);
+				stream_.read(t_compressed.data(), (std::streamsize)bytes);
+				if (!stream_) {
+					Log(FUNCTION_ERROR("ERROR: ACE: Could not read entry \"%s\"."), entry_id);
+					return 0;
+				}
+				ACE_STAT_ADD(stats_.bytes_read, bytes);
+			}
+			else if (damaged) {
+				Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is damaged; its seek table doesn't match it."), entry_id);
+				return 0;
+			}
+			else {
+				frame_sizes.clear();
+				seek_pos(data_pos);
+				parse_bytes(t_compressed, compressed_size);
+				ACE_STAT_ADD(stats_.bytes_read, compressed_size);
+				if (!verify(index_.find(entry_id)->second, t_compressed.data(), compressed_size)) {
+					Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is corrupt; its checksum doesn't match."), entry_id);
+					return 0;
+				}
+			}
+		}
+
+		if (frame_sizes.empty()) {	// Not framed: decompressed from the start to the end of the range
+			const size_t end = (size_t)offset + length;
+			t_frame.resize(end);
+			if (decompress_prefix(t_frame.data(), end, t_compressed.data(), compressed_size) != end) { return 0; }
+			memcpy(dst, t_frame.data() + offset, length);
+			return length;
+		}
+
+		ACE_TRACE_SCOPE("ace", "decompress", entry_id);
+		ACE_STAT_TIME(stats_.decompress_ns);
+		const char* src = t_compressed.data();
+		unsigned int written = 0;
+		for (size_t i = first; i <= last; i++) {
+			const unsigned int frame_start = (unsigned int)(i * frame_size);
+			const unsigned int frame_bytes = std::min(frame_size, entry.size - frame_start);
+			const unsigned int from = std::max(offset, frame_start) - frame_start;
+			const unsigned int to = std::min(offset + length, frame_start + frame_bytes) - frame_start;
+			// Frames the range covers entirely go straight to 'dst'.
+			unsigned char* out = (from == 0 && to == frame_bytes) ? dst + written : nullptr;
+			if (out == nullptr) {
+				t_frame.resize(frame_size);
+				out = t_frame.data();
+			}
+			const size_t size = ZSTD_decompress_usingDDict(t_dctx.ctx, out, frame_bytes, src, frame_sizes[i], ddict_);
+			if (ZSTD_isError(size) || size != frame_bytes) { return 0; }
+			ACE_STAT_ADD(stats_.bytes_decompressed, size);
+			if (out == t_frame.data()) { memcpy(dst + written, out + from, to - from); }
+			written += to - from;
+			src += frame_sizes[i];
+		}
+		return written;
+	}
+
+	EX_ace_entry_cpp find(const char* entry_id, unsigned int& compressed_size, bool read_data = true) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return find_locked(entry_id, compressed_size, read_data);
+	}
+
+	// find() for callers that already hold 'mutex_'; without 'read_data', the stream is left at
+	// the entry's data. Members of solid blocks are served from the block cache; their data is
+	// in 't_solid' rather than 't_compressed'.
+	EX_ace_entry_cpp find_locked(const char* entry_id, unsigned int& compressed_size, bool read_data = true) {
+		t_solid = {};
+		if (!is_valid_) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Not an ace file! Seeking failed."));
+			return {};
+		}
+		auto it = index_.find(entry_id);
+		if (it == index_.end()) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not find entry \"%s\"."), entry_id);
+			return {};
+		}
+
+		ACE_TRACE_SCOPE("ace", "read", entry_id);
+		ACE_STAT_TIME(stats_.io_ns);
+		const std::streamoff pos = it->second;
+		if (std::shared_ptr<const ace_block> block = cached_block(pos)) {
+			ACE_STAT_ADD(stats_.cache_hits, 1);
+			return solid_member(std::move(block), entry_id, compressed_size);
+		}
+		EX_ace_entry_cpp entry;
+		if (profiled_ && s_readahead != 0) { entry = read_ahead(pos, compressed_size, read_data); }
+		else {
+			seek_pos(pos);
+			entry = parse_entry(compressed_size, read_data);
+			if (read_data) { ACE_STAT_ADD(stats_.bytes_read, compressed_size); }
+		}
+		if (entry.id == "") {
+			Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is damaged; its header can't be read."), entry_id);
+			return {};
+		}
+		const bool is_block = entry.id == EX_ACE_BLOCK_ID;
+		if (is_block && !read_data) {	// The block is needed either way
+			parse_bytes(t_compressed, compressed_size);
+			ACE_STAT_ADD(stats_.bytes_read, compressed_size);
+		}
+		if ((read_data || is_block) && !verify(pos, t_compressed.data(), compressed_size)) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Entry \"%s\" is corrupt; its checksum doesn't match."), entry_id);
+			return {};
+		}
+		if (!is_block) { return entry; }
+
+		std::shared_ptr<const ace_block> block = load_block(pos, entry.size, compressed_size);
+		if (block == nullptr) {
+			Log(FUNCTION_ERROR("ERROR: ACE: The solid block holding \"%s\" is damaged."), entry_id);
+			return {};
+		}
+		return solid_member(std::move(block), entry_id, compressed_size);
+	}
+
+	~ace_iterator() {
+		if (stream_.is_open()) { stream_.close(); }
+		ZSTD_freeDDict(ddict_);
+	};
+};
+
+struct ace_mount {
+	ace_archive handle;
+	int priority;
+	std::shared_ptr<ace_iterator> archive;
+};
+
+// Highest priority first; among equals, the latest mount comes first.
+static std::vector<ace_mount> s_mounts;
+static std::shared_mutex s_mounts_mutex;
+static ace_archive s_next_archive = 0;
+static ace_archive s_default_archive = ACE_INVALID_ARCHIVE;
+
+// Access profile being recorded (see StartProfile()): each tag's first access, in order.
+static std::atomic<bool> s_profiling(false);
+static std::mutex s_profile_mutex;	// Guards the profile below
+static uint64_t s_profile_start = 0;
+static std::unordered_set<std::string> s_profile_seen;
+static std::vector<std::pair<uint64_t, std::string>> s_profile;	// Microseconds since StartProfile() & tag
+
+static void RecordAccess(const char* tag) {
+	if (!s_profiling.load(std::memory_order_relaxed)) { return; }
+	const uint64_t now = trace::Now();
+	std::lock_guard<std::mutex> lock(s_profile_mutex);
+	if (s_profiling && s_profile_seen.insert(tag).second) {
+		s_profile.emplace_back((now - s_profile_start) / 1000, tag);
+	}
+}
+
+// Tags listed by a profile file, mapped to their rank; empty if it can't be read.
+static std::unordered_map<std::string, size_t> LoadProfile(const std::string& path) {
+	std::unordered_map<std::string, size_t> ranks;
+	std::ifstream in(path);
+	if (!in) {
+		Log(FUNCTION_ERROR("ERROR: ACE: Could not open profile! (%s)"), path.c_str());
+		return ranks;
+	}
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line[0] == '#') { continue; }
+		const size_t space = line.find(' ');
+		if (space == std::string::npos || space + 1 >= line.size()) { continue; }
+		ranks.emplace(line.substr(space + 1), ranks.size());
+	}
+	return ranks;
+}
+
+typedef std::vector<std::pair<std::string, std::vector<std::string>>> ace_bundles;	// Names & tags
+
+// Bundles listed by a manifest: a "[name]" line starts a bundle, the lines after it are its
+// tags; empty if it can't be read.
+static ace_bundles LoadBundles(const std::string& path) {
+	ace_bundles bundles;
+	std::ifstream in(path);
+	if (!in) {
+		Log(FUNCTION_ERROR("ERROR: ACE: Could not open bundle manifest! (%s)"), path.c_str());
+		return bundles;
+	}
+	std::string line;
+	while (std::getline(in, line)) {
+		if (!line.empty() && line.back() == '\r') { line.pop_back(); }
+		if (line.empty() || line[0] == '#') { continue; }
+		if (line.front() == '[' && line.back() == ']') { bundles.emplace_back(line.substr(1, line.size() - 2), std::vector<std::string>()); }
+		else if (!bundles.empty()) { bundles.back().second.push_back(line); }
+	}
+	return bundles;
+}
+
+// The archive an entry is loaded from: the first mount that has it. Loads keep it alive even if
+// it's unmounted meanwhile.
+static std::shared_ptr<ace_iterator> Resolve(const char* tag) {
+	std::shared_lock<std::shared_mutex> lock(s_mounts_mutex);
+	for (auto& mount : s_mounts) {
+		if (mount.archive->contains(tag)) {
+			RecordAccess(tag);
+			return mount.archive;
+		}
+	}
+	if (s_mounts.empty()) { Log(FUNCTION_ERROR("ERROR: ACE: No ace file is mounted! Seeking failed.")); }
+	else { Log(FUNCTION_ERROR("ERROR: ACE: Could not find entry \"%s\"."), tag); }
+	return nullptr;
+}
+
+// The archive a bundle is loaded from: the first mount that has it; its members all come from
+// that archive.
+static std::shared_ptr<ace_iterator> ResolveBundle(const char* name) {
+	std::shared_lock<std::shared_mutex> lock(s_mounts_mutex);
+	for (auto& mount : s_mounts) {
+		if (mount.archive->has_bundle(name)) { return mount.archive; }
+	}
+	if (s_mounts.empty()) { Log(FUNCTION_ERROR("ERROR: ACE: No ace file is mounted! Seeking failed.")); }
+	else { Log(FUNCTION_ERROR("ERROR: ACE: Could not find bundle \"%s\"."), name); }
+	return nullptr;
+}
+
+struct ace_atlas {
+	std::string name;
+	std::vector<std::string> tags;
+	int width;
+	int height;
+	int flags;
+};
+
+static std::vector<ace_atlas> s_atlases;
+static ace::ace_atlas_baker s_atlas_baker = nullptr;	// Set by lsqueezer's EnableBaking() (see SetAtlasBaker())
+static const char* s_atlas_type = "";
+
+// A record's header, as it's written before its data.
+static std::string RecordHeader(const std::string& id, const std::string& ext, size_t size, size_t compressed_size) {
+	std::ostringstream header;
+	header << std::quoted(id) << EX_ACE_DELIM << ext << EX_ACE_DELIM << size << EX_ACE_DELIM << compressed_size << EX_ACE_DELIM;
+	return header.str();
+}
+
+// Compresses every 's_frame_size' bytes as a frame of their own, behind a seek table; returns
+// the checksum of the record written.
+static uint64_t WriteFramedEntry(std::ostream& out, ZSTD_CCtx* cctx, const ZSTD_CDict* cdict,
+	const std::string& id, const std::string& ext, const char* src_buf, const size_t src_size) {
+	const size_t frame_count = (src_size + s_frame_size - 1) / s_frame_size;
+	std::string table;
+	PutU32(table, EX_ACE_SEEK_MAGIC);
+	PutU32(table, (uint32_t)(8 + frame_count * sizeof(uint32_t)));
+	PutU32(table, s_frame_size);
+	PutU32(table, (uint32_t)frame_count);
+
+	std::string frames;
+	std::vector<char> dst_buf(ZSTD_compressBound(s_frame_size));
+	for (size_t i = 0; i < frame_count; i++) {
+		const size_t frame_start = i * s_frame_size;
+		const size_t frame_bytes = std::min((size_t)s_frame_size, src_size - frame_start);
+		const size_t dst_size = ZSTD_compress_usingCDict(cctx, dst_buf.data(), dst_buf.size(), src_buf + frame_start, frame_bytes, cdict);
+		PutU32(table, (uint32_t)dst_size);
+		frames.append(dst_buf.data(), dst_size);
+	}
+	table.append(frames);
+	const std::string header = RecordHeader(id, ext, src_size, table.size());
+	out.write(header.data(), header.size());
+	out.write(table.data(), table.size()) << EX_ACE_DELIM;
+	return RecordChecksum(header.data(), header.size(), table.data(), table.size());
+}
+
+// Compresses a record as a single frame; returns the checksum of the record written.
+static uint64_t WriteRecord(std::ostream& out, ZSTD_CCtx* cctx, const ZSTD_CDict* cdict,
+	const std::string& id, const std::string& ext, const char* src_buf, const size_t src_size) {
+	const size_t dst_capacity = ZSTD_compressBound(src_size);
+	char* dst_buf = (char*)malloc(dst_capacity * sizeof(char));
+	const size_t dst_size = ZSTD_compress_usingCDict(cctx, dst_buf, dst_capacity, src_buf, src_size, cdict);
+	const std::string header = RecordHeader(id, ext, src_size, dst_size);
+	out.write(header.data(), header.size());
+	out.write(dst_buf, dst_size) << EX_ACE_DELIM;
+	const uint64_t checksum = RecordChecksum(header.data(), header.size(), dst_buf, dst_size);
+	free(dst_buf);
+	return checksum;
+}
+
+static void WriteEntry(std::ostream& out, ZSTD_CCtx* cctx, const ZSTD_CDict* cdict, ace_toc& toc,
+	const std::string& id, const std::string& ext, const char* src_buf, const size_t src_size) {
+	const uint64_t pos = (uint64_t)out.tellp();
+	const uint64_t checksum = (s_frame_size != 0 && src_size > s_frame_size) ?
+		WriteFramedEntry(out, cctx, cdict, id, ext, src_buf, src_size) : WriteRecord(out, cctx, cdict, id, ext, src_buf, src_size);
+	toc.push_back({ id, pos, checksum, (uint64_t)out.tellp() - pos });
+}
+
+// Small entries waiting to be written together as a solid block (see SetSolidBlocks()).
+struct ace_solid_block {
+	std::vector<std::pair<std::string, std::string>> members;	// Ids & types
+	std::vector<uint32_t> sizes;
+	std::string data;
+};
+
+// Writes a solid block & empties it; every member's index entry points at the block's record.
+static void WriteBlock(std::ostream& out, ZSTD_CCtx* cctx, const ZSTD_CDict* cdict, ace_toc& toc, ace_solid_block& block) {
+	size_t table_size = 4;
+	for (auto& member : block.members) { table_size += 4 + member.first.size() + 4 + member.second.size() + 8; }
+	std::string record;
+	PutU32(record, (uint32_t)block.members.size());
+	uint32_t offset = (uint32_t)table_size;
+	for (size_t i = 0; i < block.members.size(); i++) {
+		PutU32(record, (uint32_t)block.members[i].first.size());
+		record.append(block.members[i].first);
+		PutU32(record, (uint32_t)block.members[i].second.size());
+		record.append(block.members[i].second);
+		PutU32(record, offset);
+		PutU32(record, block.sizes[i]);
+		offset += block.sizes[i];
+	}
+	record.append(block.data);
+
+	const uint64_t pos = (uint64_t)out.tellp();
+	const uint64_t checksum = WriteRecord(out, cctx, cdict, EX_ACE_BLOCK_ID, EX_ACE_BLOCK_TYPE, record.data(), record.size());
+	for (auto& member : block.members) { toc.push_back({ member.first, pos, checksum, (uint64_t)out.tellp() - pos }); }
+	block = {};
+}
+
+// The index record closes the file; its data is stored as is. 'flags' are EX_ACE_INDEX_*.
+static void WriteIndex(std::ostream& out, const ace_toc& toc, uint32_t flags, const ace_bundle_index& bundles, const ace_sources* sources) {
+	std::string table;
+	PutU32(table, (uint32_t)toc.size());
+	for (auto& entry : toc) {
+		PutU32(table, (uint32_t)entry.id.size());
+		table.append(entry.id);
+		PutU64(table, entry.pos);
+	}
+	flags &= ~(EX_ACE_INDEX_BUNDLES | EX_ACE_INDEX_SOURCES);
+	if (!bundles.empty()) { flags |= EX_ACE_INDEX_BUNDLES; }
+	if (sources != nullptr) { flags |= EX_ACE_INDEX_SOURCES; }
+	flags |= EX_ACE_INDEX_CHECKSUMS;
+	PutU32(table, flags);
+	if (!bundles.empty()) {
+		PutU32(table, (uint32_t)bundles.size());
+		for (auto& bundle : bundles) {
+			PutU32(table, (uint32_t)bundle.first.size());
+			table.append(bundle.first);
+			PutU32(table, (uint32_t)bundle.second.size());
+			for (auto& member : bundle.second) {
+				PutU32(table, (uint32_t)member.first);
+				PutU64(table, member.second);
+			}
+		}
+	}
+	for (auto& entry : toc) {
+		PutU64(table, entry.checksum);
+		PutU64(table, entry.size);
+	}
+	if (sources != nullptr) {
+		PutU32(table, (uint32_t)sources->size());
+		for (auto& source : *sources) {
+			PutU32(table, (uint32_t)source.first.size());
+			table.append(source.first);
+			PutU32(table, (uint32_t)source.second.size());
+			table.append(source.second);
+		}
+	}
+	const size_t record_size = table.size() + EX_ACE_TRAILER_SIZE;
+	out << std::quoted(EX_ACE_INDEX_ID) << EX_ACE_DELIM << "idx" << EX_ACE_DELIM << record_size << EX_ACE_DELIM;
+	out << record_size << EX_ACE_DELIM;
+	const uint64_t table_pos = (uint64_t)out.tellp();
+	std::string trailer;
+	PutU64(trailer, table_pos);
+	trailer.append(EX_ACE_INDEX_MAGIC, 8);
+	out.write(table.data(), table.size());
+	out.write(trailer.data(), trailer.size()) << EX_ACE_DELIM;
+}
+
+// A resource file's contents, allocated through ace (entries free their data through it); NULL
+// if it can't be read.
+static char* ReadSource(const fs::path& path, size_t& size) {
+	std::ifstream in(path, std::ios::in | std::ios::binary);
+	if (!in) {
+		Log(FUNCTION_ERROR("ERROR: ACE: Could not open file! (\"%s\")"), path.string().c_str());
+		return nullptr;
+	}
+	std::filebuf* buf = in.rdbuf();
+	size = buf->pubseekoff(0, in.end, in.in);
+	buf->pubseekpos(0, in.in);
+	char* data = (char*)ace::Alloc(size);
+	in.read(data, size);
+	return data;
+}
+
+// What AppendContent() & Compact() keep of an existing file, besides its index.
+struct ace_header {
+	std::string dict;
+	std::streamoff hash_pos = 0;	// Where the directory hash starts
+	std::streamoff data_pos = 0;	// Where the first record starts
+};
+
+// Reads the header written by Generate(): magic, hash & dictionary; false if it isn't an ace file.
+static bool ReadHeader(std::istream& in, ace_header& header) {
+	in.clear();
+	in.seekg(0, std::ios::beg);
+	int magic = 0;
+	in >> magic;
+	if (!in || magic != 0xACE || in.get() != EX_ACE_DELIM) { return false; }
+	header.hash_pos = in.tellg();
+	in.seekg(16 + 1, std::ios::cur);	// Hash & delim
+	size_t dict_size = 0;
+	in >> dict_size;
+	if (!in || in.get() != EX_ACE_DELIM) { return false; }
+	header.dict.resize(dict_size);
+	in.read(&header.dict[0], dict_size);
+	if (!in || in.get() != EX_ACE_DELIM) { return false; }
+	header.data_pos = in.tellg();
+	return true;
+}
+
+// Reads the header of the record at the current position, up to its data; false if it's damaged.
+static bool ReadRecordHeader(std::istream& in, uint64_t& data_size) {
+	std::string value;	// The last header value: the compressed size
+	for (int delims = 0; delims < 4;) {
+		const int c = in.get();
+		if (c == EOF) { return false; }
+		if (c != EX_ACE_DELIM) { value += (char)c; }
+		else if (++delims < 4) { value.clear(); }
+	}
+	return ParseNumber(value, EX_ACE_STREAMSIZE_MAX, data_size);
+}
+
+// Where the record starting at 'pos' ends, its closing delim included; 0 if it's damaged.
+static uint64_t RecordEnd(std::istream& in, uint64_t pos) {
+	in.clear();
+	in.seekg((std::streamoff)pos);
+	uint64_t data_size = 0;
+	if (!ReadRecordHeader(in, data_size)) { return 0; }
+	return (uint64_t)in.tellg() + data_size + 1;
+}
+
+// Every file inside 'path' & when it was last modified, in directory order.
+static ace_sources ReadSources(const char* path) {
+	namespace fs = std::filesystem;
+	ace_sources sources;
+	// This is not portable at ALL!!!!!!
+	for (auto& entry : fs::directory_iterator(path)) {
+		if (entry.is_regular_file()) {
+			std::string entry_path = entry.path().string();
+			std::replace(entry_path.begin(), entry_path.end(), '\\', '/');
+			std::string modified;
+			struct stat info;
+			if (stat(entry_path.c_str(), &info) == 0) {
+				modified = std::to_string(info.st_mtime);
+			}
+			sources.emplace_back(entry.path().filename().string(), std::move(modified));
+		}
+	}
+	return sources;
+}
+
+static unsigned char* SourcesMD5(const ace_sources& sources) {
+	std::string md5_buffer;
+	MD5_CTX ctx = { 0 };
+	MD5_Init(&ctx);
+	for (auto& source : sources) {
+		md5_buffer.append(source.first).append(source.second);
+	}
+	// Registered atlases are part of what the file is made from, so changing them regenerates it.
+	for (auto& atlas : s_atlases) {
+		md5_buffer.append(atlas.name);
+		for (auto& tag : atlas.tags) { md5_buffer.append(1, EX_ACE_DELIM).append(tag); }
+		md5_buffer.append(1, EX_ACE_DELIM).append(std::to_string(atlas.width));
+		md5_buffer.append(1, EX_ACE_DELIM).append(std::to_string(atlas.height));
+		md5_buffer.append(1, EX_ACE_DELIM).append(std::to_string(atlas.flags));
+	}
+	MD5_Update(&ctx, md5_buffer.c_str(), md5_buffer.size());
+	unsigned char* ret = (unsigned char*)malloc(16 * sizeof(unsigned char));
+	MD5_Final(ret, &ctx);
+	return ret;
+}
+
+static unsigned char* CheckDirectoryMD5(const char* path) {
+	return SourcesMD5(ReadSources(path));
+}
+
+// Decompresses a batch of entries back to back into one allocation; 'entries' only get their
+// headers, each entry's data is at the matching offset. With 'with_strings', room for every
+// id & type is left at the end of the arena, which 'strings' is set to.
+static unsigned char* LoadArena(const char* tags[], int count, std::vector<EX_ace_entry_cpp>& entries,
+	std::vector<size_t>& offsets, bool with_strings, unsigned char*& strings) {
+	std::vector<EX_ace_entry_cpp> headers;
+	std::vector<std::shared_ptr<ace_iterator>> archives;
+	size_t data_bytes = 0;
+	size_t string_bytes = 0;
+	for (int i = 0; i < count; i++) {
+		std::shared_ptr<ace_iterator> archive = Resolve(tags[i]);
+		if (archive == nullptr) { continue; }
+		EX_ace_entry_cpp header = archive->peek(tags[i]);
+		if (header.id == "") { continue; }
+		data_bytes += ArenaAlign(header.size);
+		if (with_strings) { string_bytes += header.id.size() + header.type.size() + 2; }
+		headers.push_back(std::move(header));
+		archives.push_back(std::move(archive));
+	}
+
+	unsigned char* arena = (unsigned char*)ace::Alloc(data_bytes + string_bytes + 1);
+	if (arena == nullptr) {
+		Log(FUNCTION_ERROR("ERROR: ACE: Could not allocate an arena of %llu bytes."), (unsigned long long)(data_bytes + string_bytes));
+		return nullptr;
+	}
+	size_t offset = 0;
+	entries.reserve(headers.size());
+	offsets.reserve(headers.size());
+	for (size_t i = 0; i < headers.size(); i++) {
+		EX_ace_entry_cpp& header = headers[i];
+		if (archives[i]->load_into(header.id.c_str(), arena + offset, header.size) != header.size) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not decompress entry \"%s\"."), header.id.c_str());
+			continue;
+		}
+		offsets.push_back(offset);
+		offset += ArenaAlign(header.size);
+		entries.push_back(std::move(header));
+	}
+	strings = arena + offset;
+	return arena;
+}
+
+// Entries that share an arena loaded by LoadArena() or a bundle; the arena goes away with the
+// last of them.
+static ace_buffer ShareArena(unsigned char* raw, std::vector<EX_ace_entry_cpp>& entries, const std::vector<size_t>& offsets) {
+	ace_buffer elements;
+	if (raw == nullptr) { return elements; }
+	std::shared_ptr<unsigned char> arena(raw, ace::Free);
+	elements.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); i++) {
+		entries[i].arena = arena;
+		entries[i].data = arena.get() + offsets[i];
+		elements.emplace_back(std::make_shared<EX_ace_entry_cpp>(std::move(entries[i])));
+	}
+	return elements;
+}
+
+namespace ace {
+	void* Alloc(size_t size) {
+		return s_allocator.alloc(s_allocator.user, size);
+	}
+
+	void Free(void* ptr) {
+		if (ptr != nullptr) { s_allocator.free(s_allocator.user, ptr); }
+	}
+
+	void SetAllocator(const ace_allocator* allocator) {
+		if (allocator == NULL) { s_allocator = { DefaultAlloc, DefaultFree, NULL }; }
+		else { s_allocator = *allocator; }
+	}
+
+	void SetLog(FILE* stream) {
+		s_log = stream;
+	}
+
+	void SetFrameSize(unsigned int frame_size) {
+		s_frame_size = frame_size;
 	}
 
-	ace_iterator* Prime() {
-		if (stream_.is_open()) {
-			stream_.close();
-		}
+	void SetProfile(const char* path) {
+		s_profile_path = path != NULL ? path : "";
+	}
 
-		Log("LOG: ACE: Primed file information:");
-		
-		stream_.open(s_default_path, std::ios::in | std::ios::binary);
-		if (!stream_) {
-			Log(FUNCTION_ERROR("ERROR: ACE: Could not open ace file! (%s)"), s_default_path.c_str());
-			return NULL;
-		}
+	void SetBundles(const char* path) {
+		s_bundles_path = path != NULL ? path : "";
+	}
 
-		Log(" | Path: %s", s_default_path.c_str());
+	void SetReadahead(unsigned int bytes) {
+		s_readahead = bytes;
+	}
 
-		std::locale x(std::locale::classic(), new ace_facet);	// does this leak?
-		stream_.imbue(x);
-		stream_.clear();
-		stream_.seekg(0, std::ios::beg);	// Seek the beggining just in case
-		
-		int magicNumber = std::stoi(std::move(parse_value()));
+	void SetSolidBlocks(unsigned int entry_size, unsigned int block_size) {
+		s_solid_entry_size = entry_size;
+		s_solid_block_size = block_size != 0 ? block_size : 64 * 1024;
+	}
 
-		Log(" | Magic #: %d", magicNumber);
+	void SetBlockCache(unsigned int bytes) {
+		s_block_cache = bytes;
+	}
 
-		is_valid_ = magicNumber == 0xACE ? true : false;
+	void SetVerify(int mode) {
+		s_verify = mode;
+	}
 
-		Log(" | Valid: %s", is_valid_ ? "true" : "false");
-		
-		if (!is_valid_) {
-			return NULL;
+	int Verify(const char* path) {
+		ACE_TRACE_SCOPE("ace", "Verify", path);
+		std::ifstream in(path, std::ios::in | std::ios::binary);
+		ace_toc toc;
+		uint32_t flags = 0;
+		ace_bundle_index bundles;
+		if (!in || !ReadIndex(in, toc, flags, bundles)) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not open an indexed ace file to verify! (%s)"), path);
+			return 0;
+		}
+		in.close();
+		if ((flags & EX_ACE_INDEX_CHECKSUMS) == 0) {
+			Log(FUNCTION_ERROR("ERROR: ACE: The ace file has no checksums; generate it again. (%s)"), path);
+			return 0;
 		}
 
-		char* buffer = parse_bytes(16);
-		printf(" | Hash: 0x");
-		for (int i = 0; i < 16; i++) {
-			unsigned char x = (unsigned char)buffer[i];
-			if (x <= 0xF) {
-				printf("0%d", x);
-			}
-			else {
-				printf("%1X", x);
+		// Every record once, in file order. Runs of neighbors go to whichever thread is free, each
+		// reading through a stream of its own, so several reads are in flight at once.
+		std::vector<const ace_toc_entry*> records;
+		for (auto& entry : toc) {
+			if (entry.size != 0) { records.push_back(&entry); }
+		}
+		std::sort(records.begin(), records.end(), [](const ace_toc_entry* a, const ace_toc_entry* b) { return a->pos < b->pos; });
+		records.erase(std::unique(records.begin(), records.end(),
+			[](const ace_toc_entry* a, const ace_toc_entry* b) { return a->pos == b->pos; }), records.end());
+		std::vector<std::pair<size_t, size_t>> runs;	// First record & the one past the last
+		for (size_t i = 0; i < records.size(); i++) {
+			const bool follows = i != 0 && records[i - 1]->pos + records[i - 1]->size == records[i]->pos;
+			if (runs.empty() || !follows || records[i]->pos + records[i]->size - records[runs.back().first]->pos > EX_ACE_VERIFY_CHUNK) {
+				runs.emplace_back(i, i);
 			}
+			runs.back().second = i + 1;
 		}
-		printf("\n");
 
-		const size_t dict_size = std::stoi(std::move(parse_value()));
-		
-		Log(" | Dict. size: %d", dict_size);
+		std::vector<char> corrupt(records.size(), 0);
+		std::atomic<size_t> next_run(0);
+		auto worker = [&]() {
+			std::vector<char> stream_buffer(EX_ACE_VERIFY_CHUNK);
+			std::vector<char> buffer(1024 * 1024);
+			std::ifstream file;
+			file.rdbuf()->pubsetbuf(stream_buffer.data(), stream_buffer.size());
+			file.open(path, std::ios::in | std::ios::binary);
+			XXH64_state_t* state = XXH64_createState();
+			for (size_t run; (run = next_run++) < runs.size();) {
+				file.clear();
+				file.seekg((std::streamoff)records[runs[run].first]->pos);
+				for (size_t i = runs[run].first; i < runs[run].second; i++) {
+					XXH64_reset(state, 0);
+					for (uint64_t left = records[i]->size - 1; left > 0 && file;) {	// Header & data
+						const size_t bytes = (size_t)std::min<uint64_t>(left, buffer.size());
+						file.read(buffer.data(), bytes);
+						XXH64_update(state, buffer.data(), bytes);
+						left -= bytes;
+					}
+					file.ignore();	// skip delim
+					corrupt[i] = !file || XXH64_digest(state) != records[i]->checksum;
+				}
+			}
+			XXH64_freeState(state);
+		};
+		int threads = (int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), runs.size());
+		std::vector<std::thread> pool;
+		for (int t = 1; t < threads; t++) { pool.emplace_back(worker); }
+		worker();
+		for (auto& thread : pool) { thread.join(); }
 
-		char* dict = (char*)malloc(dict_size * sizeof(char));
-		stream_.read((char*)dict, dict_size);
-		if (stream_.peek() == EX_ACE_DELIM) {
-			stream_.ignore();	// skip delim
+		std::unordered_set<uint64_t> damaged;
+		for (size_t i = 0; i < records.size(); i++) {
+			if (corrupt[i]) { damaged.insert(records[i]->pos); }
 		}
-		pos_ = std::move(stream_.tellg());
-		dctx_ = ZSTD_createDCtx();
-		ddict_ = ZSTD_createDDict(dict, dict_size);
-		free(dict);
-
-		return this;
+		for (auto& entry : toc) {
+			if (damaged.count(entry.pos) != 0) { Log("ERROR: ACE: Entry \"%s\" is corrupt; its checksum doesn't match.", entry.id.c_str()); }
+		}
+		Log("LOG: ACE: Verified %s (%d records, %d corrupt)", path, (int)records.size(), (int)damaged.size());
+		return damaged.empty() ? 1 : 0;
 	}
 
-	ace_entry operator[](const char* entry_id) {
-		if (!is_valid_) {
-			Log(FUNCTION_ERROR("ERROR: ACE: Not an ace file! Seeking failed."));
-		}
+	void StartProfile() {
+		std::lock_guard<std::mutex> lock(s_profile_mutex);
+		s_profile.clear();
+		s_profile_seen.clear();
+		s_profile_start = trace::Now();
+		s_profiling = true;
+	}
 
-		std::streampos init_pos = pos_;
-		stream_.clear();
-		auto visited_it = std::find_if(visited_.begin(), visited_.end(),
-			[&](ace_pointer& ref) { return ref.id == entry_id; });
-		if (visited_it != visited_.end()) {	// element has been visited previously!
-			seek_pos(visited_it->pos);
-			return parse_entry();
+	int StopProfile(const char* path) {
+		std::vector<std::pair<uint64_t, std::string>> profile;
+		{
+			std::lock_guard<std::mutex> lock(s_profile_mutex);
+			if (!s_profiling) { return 0; }
+			s_profiling = false;
+			profile.swap(s_profile);
+			s_profile_seen.clear();
 		}
-
-		ace_pointer ptr = query_pointer();
-		if (ptr.id == entry_id) {
-			return parse_entry();
+		std::ofstream out(path, std::ios::out | std::ios::trunc);
+		if (!out) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not write profile! (%s)"), path);
+			return 0;
 		}
-		while (ptr.id != entry_id && !stream_.eof() && ptr.id.size() != 0) {	// read until found
-			skip_entry();
-			ptr = query_pointer();
-			if (ptr.id.size() == 0) {
-				break;
-			}
-
-			if (ptr.id == entry_id) {
-				return parse_entry();
-			}
+		out << "# ace access profile: microseconds since StartProfile() & tag, in first-access order\n";
+		for (auto& access : profile) {
+			out << access.first << ' ' << access.second << '\n';
 		}
-		// return to the beggining of search if not found
-		Log(FUNCTION_ERROR("ERROR: ACE: Could not find entry \"%s\"."), entry_id);
-		seek_pos(init_pos);
-		return {};
+		return 1;
 	}
 
-	~ace_iterator() {
-		if (stream_.is_open()) { stream_.close(); }
-		ZSTD_freeDCtx(dctx_);
-		ZSTD_freeDDict(ddict_);
-	};
-};
-
-static unsigned char* CheckDirectoryMD5(const char* path) {
-	namespace fs = std::filesystem;
-	std::string md5_buffer;
-	MD5_CTX ctx = { 0 };
-	MD5_Init(&ctx);
-	// This is not portable at ALL!!!!!!
-	for (auto& entry : fs::directory_iterator(path)) {
-		if (entry.is_regular_file()) {
-			std::string entry_path = entry.path().string();
-			std::replace(entry_path.begin(), entry_path.end(), '\\', '/');
-			std::string entry_info = entry.path().filename().string();
-			struct stat info;
-			if (stat(entry_path.c_str(), &info) == 0) {
-				entry_info.append(std::to_string(info.st_mtime));
-			}
-			md5_buffer.append(entry_info);
-		}
+	bool UsesDefaultAllocator() {
+		return s_allocator.alloc == DefaultAlloc;
 	}
-	MD5_Update(&ctx, md5_buffer.c_str(), md5_buffer.size());
-	unsigned char* ret = (unsigned char*)malloc(16 * sizeof(unsigned char));
-	MD5_Final(ret, &ctx);
-	return ret;
-}
 
-namespace ace {
 	int Init(int default_compression_level, const char* res_path, const char* ace_path, const char* ace_name, bool scan_changes) {
+		ACE_TRACE_SCOPE("ace", "Init", ace_name);
 		Log("LOG: ACE: Initializing...");
 		s_default_level = default_compression_level;
 		fs::path fmt_path = fs::path(ace_path) / (std::string(ace_name) + ".ace");
@@ -349,26 +1693,55 @@ namespace ace {
 			free(md5_ace);
 			free(md5_dir);
 		}
-		ace_iterator::Get().Prime();
-		return 1;
+		// Re-initializing swaps the default archive out; whatever else is mounted stays.
+		Unmount(s_default_archive);
+		s_default_archive = Mount(s_default_path.c_str(), 0);
+		return s_default_archive != ACE_INVALID_ARCHIVE ? 1 : 0;
 	}
 
 	void Stop() {
-		// EMPTY
+		std::unique_lock<std::shared_mutex> lock(s_mounts_mutex);
+		s_mounts.clear();
+		s_default_archive = ACE_INVALID_ARCHIVE;
+	}
+
+	ace_archive Mount(const char* path, int priority) {
+		ACE_TRACE_SCOPE("ace", "Mount", path);
+		std::shared_ptr<ace_iterator> archive = std::make_shared<ace_iterator>();
+		if (archive->Prime(path) == NULL) { return ACE_INVALID_ARCHIVE; }
+
+		std::unique_lock<std::shared_mutex> lock(s_mounts_mutex);
+		auto it = std::find_if(s_mounts.begin(), s_mounts.end(),
+			[&](const ace_mount& mount) { return mount.priority <= priority; });
+		const ace_archive handle = s_next_archive++;
+		s_mounts.insert(it, { handle, priority, std::move(archive) });
+		return handle;
+	}
+
+	void Unmount(ace_archive archive) {
+		std::unique_lock<std::shared_mutex> lock(s_mounts_mutex);
+		auto it = std::find_if(s_mounts.begin(), s_mounts.end(),
+			[&](const ace_mount& mount) { return mount.handle == archive; });
+		if (it != s_mounts.end()) { s_mounts.erase(it); }
 	}
 
 	int Generate(int compression_level, const char* res_path, const char* output_path, const char* output_name) {
+		ACE_TRACE_SCOPE("ace", "Generate", output_name);
 		namespace fs = std::filesystem;
+		if (!s_atlases.empty() && s_atlas_baker == nullptr) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Atlases are registered but nothing bakes them; call LS_EnableBaking() first!"));
+			return 0;
+		}
 		std::string ext;
 		std::ofstream out;
-		std::ifstream in;
 		std::string fmt_path = std::string(output_path) + '/' + output_name + ".ace";
 		out.open(std::move(fmt_path), std::ios::out | std::ios::trunc | std::ios::binary);
 		if (!out) {
 			Log(FUNCTION_ERROR("ERROR: ACE: Could not create ace file!"));
 			return 0;
 		}
-		unsigned char* md5_dir = CheckDirectoryMD5(res_path);
+		const ace_sources sources = ReadSources(res_path);	// Stored in the index for AppendContent()
+		unsigned char* md5_dir = SourcesMD5(sources);
 		(out << 0xACE << EX_ACE_DELIM).write((const char*)md5_dir, 16) << EX_ACE_DELIM;
 		free(md5_dir);
 
@@ -411,44 +1784,360 @@ namespace ace {
 		}
 		free(c_paths);
 
-		// Read and compress.
+		// Files requested by registered atlases are read & baked up front, so the layout can put
+		// the atlases anywhere; they're written from memory afterwards.
+		std::map<std::string, ace_entry> atlas_sources;	// Freed along with the map
+		for (auto& atlas : s_atlases) {
+			for (auto& tag : atlas.tags) { atlas_sources[tag] = {}; }
+		}
+		for (auto& path : paths) {
+			const fs::path file(path);
+			auto source = atlas_sources.find(file.stem().string());
+			if (source == atlas_sources.end()) { continue; }
+			size_t src_size = 0;
+			char* src_buf = ReadSource(file, src_size);
+			if (src_buf == nullptr) {
+				ZSTD_freeCDict(cdict);
+				return 0;
+			}
+			source->second = std::make_shared<EX_ace_entry_cpp>();
+			source->second->id = source->first;
+			source->second->type = file.extension().string();
+			source->second->size = (unsigned int)src_size;
+			source->second->data = (unsigned char*)src_buf;
+		}
+
+		// Bake registered atlases.
+		std::vector<std::vector<unsigned char>> baked(s_atlases.size());
+		for (size_t i = 0; i < s_atlases.size(); i++) {
+			ace_atlas& atlas = s_atlases[i];
+			ACE_TRACE_SCOPE("ace", "BakeAtlas", atlas.name.c_str());
+			Log("LOG: ACE: Baking atlas \"%s\" (%d entries)", atlas.name.c_str(), (int)atlas.tags.size());
+			ace_buffer entries;
+			for (auto& tag : atlas.tags) {
+				ace_entry& source = atlas_sources[tag];
+				if (source != nullptr) { entries.push_back(source); }
+				else { Log("ERROR: ACE: Atlas \"%s\" requested a missing file (\"%s\"); skipping it.", atlas.name.c_str(), tag.c_str()); }
+			}
+			baked[i] = s_atlas_baker(entries, atlas.width, atlas.height, atlas.flags);
+			if (baked[i].empty()) {
+				Log(FUNCTION_ERROR("ERROR: ACE: Could not bake atlas \"%s\"!"), atlas.name.c_str());
+			}
+		}
+
+		// Layout: entries listed by the profile come first, in the order they were first loaded;
+		// the rest follow in directory order, atlases last. Items below 'paths.size()' are files,
+		// the others atlases.
+		std::vector<std::pair<std::string, size_t>> layout;	// Id & item
+		for (size_t i = 0; i < paths.size(); i++) {
+			layout.emplace_back(fs::path(paths[i]).stem().string(), i);
+		}
+		for (size_t i = 0; i < baked.size(); i++) {
+			if (!baked[i].empty()) { layout.emplace_back(s_atlases[i].name, paths.size() + i); }
+		}
+		uint32_t index_flags = 0;
+		if (!s_profile_path.empty()) {
+			const std::unordered_map<std::string, size_t> ranks = LoadProfile(s_profile_path);
+			if (!ranks.empty()) {
+				Log("LOG: ACE: Laying entries out by profile (%s, %d entries)", s_profile_path.c_str(), (int)ranks.size());
+				auto rank = [&](const std::string& id) {
+					auto it = ranks.find(id);
+					return it != ranks.end() ? it->second : ranks.size();
+				};
+				std::stable_sort(layout.begin(), layout.end(), [&](const auto& a, const auto& b) { return rank(a.first) < rank(b.first); });
+				index_flags |= EX_ACE_INDEX_PROFILED;
+			}
+		}
+		// Bundles go before everything else, each in one piece; an entry shared by several
+		// bundles sits with the first one.
+		const ace_bundles bundles = s_bundles_path.empty() ? ace_bundles() : LoadBundles(s_bundles_path);
+		std::unordered_map<std::string, size_t> slots;	// Bundle members, in manifest order
+		if (!bundles.empty()) {
+			Log("LOG: ACE: Grouping entries into bundles (%s, %d bundles)", s_bundles_path.c_str(), (int)bundles.size());
+			for (auto& bundle : bundles) {
+				for (auto& tag : bundle.second) { slots.emplace(tag, slots.size()); }
+			}
+			auto slot = [&](const std::string& id) {
+				auto it = slots.find(id);
+				return it != slots.end() ? it->second : slots.size();
+			};
+			std::stable_sort(layout.begin(), layout.end(), [&](const auto& a, const auto& b) { return slot(a.first) < slot(b.first); });
+		}
+
+		// Read and compress. Small files that aren't bundled go into solid blocks, one being
+		// filled per extension; a block is written once the next member wouldn't fit, the rest
+		// at the end.
+		if (s_solid_entry_size != 0) {
+			Log("LOG: ACE: Packing entries of up to %u bytes into solid blocks of %u bytes", s_solid_entry_size, s_solid_block_size);
+		}
 		ZSTD_CCtx* cctx = ZSTD_createCCtx();
-		for (auto& entry : fs::directory_iterator(res_path)) {
-			if (entry.is_regular_file() && entry.path().has_extension() &&
-				CheckFileFormat(ACE_SUPPORTED_IMG_FILEFORMATS, entry.path(), ext) ||
-				CheckFileFormat(ACE_SUPPORTED_SND_FILEFORMATS, entry.path(), ext) ||
-				CheckFileFormat(ACE_CUSTOM_FILEFORMATS, entry.path(), ext)) {
-				in.open(entry.path(), std::ios::in | std::ios::binary);
-				if (!in) {
-					Log(FUNCTION_ERROR("ERROR: ACE: Could not open file! (\"%s\")"), entry.path().string().c_str());
-					std::string path = entry.path().string();
-					return 0;
-				}
-				std::filebuf* buf = in.rdbuf();							   // PAIN
-				const size_t src_size = buf->pubseekoff(0, in.end, in.in); // PAIN
-				buf->pubseekpos(0, in.in);								   // PAIN
-
-				char* dst_buf = (char*)malloc(EX_ACE_MAX_ALLOC_CAPACITY * sizeof(char));
-				int dst_size = 0;
-				{
-					char* src_buf = (char*)malloc(src_size);
-					in.read(src_buf, src_size);
-					dst_size = ZSTD_compress_usingCDict(cctx, dst_buf, EX_ACE_MAX_ALLOC_CAPACITY, src_buf, src_size, cdict);
-					free(src_buf);
+		ace_toc toc;
+		std::map<std::string, ace_solid_block> solid;	// By extension
+		for (auto& item : layout) {
+			if (item.second >= paths.size()) {
+				const std::vector<unsigned char>& atlas = baked[item.second - paths.size()];
+				WriteEntry(out, cctx, cdict, toc, item.first, s_atlas_type, (const char*)atlas.data(), atlas.size());
+				continue;
+			}
+			const fs::path file(paths[item.second]);
+			const std::string type = file.extension().string();
+			auto source = atlas_sources.find(item.first);
+			const bool in_memory = source != atlas_sources.end() && source->second != nullptr;
+			size_t src_size = in_memory ? source->second->size : 0;
+			char* src_buf = in_memory ? (char*)source->second->data : ReadSource(file, src_size);
+			if (src_buf == nullptr) {
+				ZSTD_freeCDict(cdict);
+				ZSTD_freeCCtx(cctx);
+				return 0;
+			}
+			if (s_solid_entry_size != 0 && src_size <= s_solid_entry_size && slots.find(item.first) == slots.end()) {
+				ace_solid_block& block = solid[type];
+				if (!block.members.empty() && block.data.size() + src_size > s_solid_block_size) { WriteBlock(out, cctx, cdict, toc, block); }
+				block.members.emplace_back(item.first, type);
+				block.sizes.push_back((uint32_t)src_size);
+				block.data.append(src_buf, src_size);
+			}
+			else { WriteEntry(out, cctx, cdict, toc, item.first, type, src_buf, src_size); }
+			if (!in_memory) { ace::Free(src_buf); }
+		}
+		for (auto& block : solid) {
+			if (!block.second.members.empty()) { WriteBlock(out, cctx, cdict, toc, block.second); }
+		}
+
+		ace_bundle_index bundle_index;
+		if (!bundles.empty()) {
+			// Records follow each other, so each one ends where the next (or the index) starts.
+			const uint64_t index_pos = (uint64_t)out.tellp();
+			std::unordered_map<std::string, size_t> numbers;
+			for (size_t i = 0; i < toc.size(); i++) { numbers.emplace(toc[i].id, i); }
+			for (auto& bundle : bundles) {
+				bundle_index.emplace_back(bundle.first, std::vector<std::pair<size_t, uint64_t>>());
+				for (auto& tag : bundle.second) {
+					auto number = numbers.find(tag);
+					if (number != numbers.end()) {
+						const size_t entry = number->second;
+						const uint64_t end = entry + 1 < toc.size() ? toc[entry + 1].pos : index_pos;
+						bundle_index.back().second.emplace_back(entry, end - toc[entry].pos);
+					}
+					else { Log("ERROR: ACE: Bundle \"%s\" lists a missing entry (\"%s\"); skipping it.", bundle.first.c_str(), tag.c_str()); }
 				}
-				out << entry.path().stem() << EX_ACE_DELIM << ext << EX_ACE_DELIM << src_size << EX_ACE_DELIM;
-				out << dst_size << EX_ACE_DELIM;
-				out.write(dst_buf, dst_size) << EX_ACE_DELIM;
-				free(dst_buf);
-				in.close();
 			}
 		}
+		WriteIndex(out, toc, index_flags, bundle_index, &sources);
+
+		ZSTD_freeCDict(cdict);
+		ZSTD_freeCCtx(cctx);
+		out.close();
+		return 1;
+	}
+
+	int AppendContent(int compression_level, const char* res_path, const char* ace_path, const char* ace_name, const char* files[], int count) {
+		ACE_TRACE_SCOPE("ace", "AppendContent", ace_name);
+		const fs::path fmt_path = fs::path(ace_path) / (std::string(ace_name) + ".ace");
+		std::fstream file(fmt_path, std::ios::in | std::ios::out | std::ios::binary);
+		ace_header header;
+		ace_toc toc;
+		uint32_t flags = 0;
+		ace_bundle_index bundles;
+		ace_sources sources;
+		unsigned char md5_ace[16] = { 0 };
+		if (!file || !ReadHeader(file, header) || !ReadIndex(file, toc, flags, bundles, &sources) ||
+			!file.seekg(header.hash_pos).read((char*)md5_ace, 16)) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not open an indexed ace file to append to! (%s)"), fmt_path.string().c_str());
+			return 0;
+		}
+		Log("LOG: ACE: Appending %d entries to %s", count, fmt_path.string().c_str());
+
+		// New records go after the current index, which becomes dead space like the records they
+		// replace; nothing already in the file is touched. If anything goes wrong, the file is
+		// cut back to where it ended.
+		file.clear();
+		file.seekp(0, std::ios::end);
+		const uint64_t file_end = (uint64_t)file.tellp();
+		auto roll_back = [&]() {
+			file.close();
+			std::error_code error;
+			fs::resize_file(fmt_path, file_end, error);
+		};
+		ZSTD_CDict* cdict = ZSTD_createCDict(header.dict.data(), header.dict.size(), compression_level < 0 ? 10 : compression_level);
+		ZSTD_CCtx* cctx = ZSTD_createCCtx();
+		const size_t appended = toc.size();	// Entries from here on were just written
+		std::vector<uint64_t> record_sizes;
+		for (int i = 0; i < count; i++) {
+			const fs::path source = fs::path(res_path) / files[i];
+			size_t src_size = 0;
+			char* src_buf = ReadSource(source, src_size);
+			if (src_buf == nullptr) {
+				ZSTD_freeCDict(cdict);
+				ZSTD_freeCCtx(cctx);
+				roll_back();
+				return 0;
+			}
+			const uint64_t start = (uint64_t)file.tellp();
+			WriteEntry(file, cctx, cdict, toc, source.stem().string(), source.extension().string(), src_buf, src_size);
+			record_sizes.push_back((uint64_t)file.tellp() - start);
+			ace::Free(src_buf);
+		}
 		ZSTD_freeCDict(cdict);
 		ZSTD_freeCCtx(cctx);
+
+		// Replaced entries drop out of the index; bundles follow their members to the new records.
+		std::unordered_map<std::string, size_t> latest;
+		for (size_t i = 0; i < toc.size(); i++) { latest[toc[i].id] = i; }
+		ace_toc live;
+		std::vector<size_t> numbers(toc.size());
+		for (size_t i = 0; i < toc.size(); i++) {
+			if (latest[toc[i].id] != i) { continue; }
+			numbers[i] = live.size();
+			live.push_back(toc[i]);
+		}
+		for (auto& bundle : bundles) {
+			for (auto& member : bundle.second) {
+				const size_t entry = latest[toc[member.first].id];
+				if (entry >= appended) { member.second = record_sizes[entry - appended]; }
+				member.first = numbers[entry];
+			}
+		}
+		// The index keeps every source file & when it was modified. The directory hash is only
+		// brought up to date if the file matched its sources, and the directory now matches them
+		// with the appended files in their new state; any other change still makes Init(...,
+		// scan_changes) regenerate the file.
+		const bool tracked = (flags & EX_ACE_INDEX_SOURCES) != 0;
+		unsigned char* md5_sources = SourcesMD5(sources);
+		const bool was_current = tracked && memcmp(md5_sources, md5_ace, 16) == 0;
+		free(md5_sources);
+		std::unordered_map<std::string, std::string> expected(sources.begin(), sources.end());
+		const ace_sources directory = ReadSources(res_path);
+		for (int i = 0; i < count; i++) {
+			const std::string name = fs::path(files[i]).filename().string();
+			auto it = std::find_if(directory.begin(), directory.end(), [&](const auto& source) { return source.first == name; });
+			if (it == directory.end()) { continue; }
+			expected[name] = it->second;
+			auto known = std::find_if(sources.begin(), sources.end(), [&](const auto& source) { return source.first == name; });
+			if (known != sources.end()) { known->second = it->second; }
+			else { sources.push_back(*it); }
+		}
+		const bool current = was_current && expected.size() == directory.size() &&
+			std::all_of(directory.begin(), directory.end(), [&](const auto& source) {
+				auto it = expected.find(source.first);
+				return it != expected.end() && it->second == source.second;
+			});
+		WriteIndex(file, live, flags, bundles, tracked ? (current ? &directory : &sources) : nullptr);
+		if (!file) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not write to ace file! (%s)"), fmt_path.string().c_str());
+			roll_back();
+			return 0;
+		}
+
+		if (current) {
+			unsigned char* md5_dir = SourcesMD5(directory);
+			file.seekp(header.hash_pos);
+			file.write((const char*)md5_dir, 16);
+			free(md5_dir);
+		}
+		else {
+			Log("LOG: ACE: Files other than the appended ones changed in %s; Init(..., scan_changes) will regenerate the file", res_path);
+		}
+		file.close();
+		return 1;
+	}
+
+	int Compact(const char* ace_path, const char* ace_name) {
+		ACE_TRACE_SCOPE("ace", "Compact", ace_name);
+		const fs::path fmt_path = fs::path(ace_path) / (std::string(ace_name) + ".ace");
+		const fs::path tmp_path = fmt_path.string() + ".tmp";
+		std::ifstream in(fmt_path, std::ios::in | std::ios::binary);
+		ace_header header;
+		ace_toc toc;
+		uint32_t flags = 0;
+		ace_bundle_index bundles;
+		ace_sources sources;
+		if (!in || !ReadHeader(in, header) || !ReadIndex(in, toc, flags, bundles, &sources)) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not open an indexed ace file to compact! (%s)"), fmt_path.string().c_str());
+			return 0;
+		}
+		std::ofstream out(tmp_path, std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!out) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not create ace file! (%s)"), tmp_path.string().c_str());
+			return 0;
+		}
+
+		// The header & every record the index points at are copied as they are, in file order;
+		// a solid block is kept whole as long as one of its members is.
+		std::vector<uint64_t> starts;
+		for (auto& entry : toc) { starts.push_back(entry.pos); }
+		std::sort(starts.begin(), starts.end());
+		starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+		std::vector<char> buffer(1024 * 1024);
+		auto copy = [&](uint64_t from, uint64_t size) {
+			in.clear();
+			in.seekg((std::streamoff)from);
+			while (size > 0 && in && out) {
+				const size_t bytes = (size_t)std::min<uint64_t>(size, buffer.size());
+				in.read(buffer.data(), bytes);
+				out.write(buffer.data(), bytes);
+				size -= bytes;
+			}
+			return in && out;
+		};
+		bool copied = copy(0, (uint64_t)header.data_pos);
+		std::unordered_map<uint64_t, uint64_t> moved;	// Where each record was & is
+		for (size_t i = 0; i < starts.size() && copied; i++) {
+			const uint64_t end = RecordEnd(in, starts[i]);
+			moved[starts[i]] = (uint64_t)out.tellp();
+			copied = end > starts[i] && copy(starts[i], end - starts[i]);
+		}
+		in.clear();
+		const uint64_t old_size = (uint64_t)in.seekg(0, std::ios::end).tellg();
+		in.close();
+
+		std::vector<size_t> order(toc.size());
+		for (size_t i = 0; i < order.size(); i++) { order[i] = i; }
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return toc[a].pos < toc[b].pos; });
+		ace_toc compacted;
+		std::vector<size_t> numbers(toc.size());
+		for (size_t i : order) {
+			numbers[i] = compacted.size();
+			compacted.push_back(toc[i]);
+			compacted.back().pos = moved[toc[i].pos];
+		}
+		for (auto& bundle : bundles) {
+			for (auto& member : bundle.second) { member.first = numbers[member.first]; }
+		}
+		if (copied) { WriteIndex(out, compacted, flags, bundles, (flags & EX_ACE_INDEX_SOURCES) != 0 ? &sources : nullptr); }
+		const uint64_t new_size = (uint64_t)out.tellp();
+		copied = copied && out;
 		out.close();
+
+		std::error_code error;
+		if (copied) { fs::rename(tmp_path, fmt_path, error); }
+		if (!copied || error) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not compact ace file! (%s)"), fmt_path.string().c_str());
+			fs::remove(tmp_path, error);
+			return 0;
+		}
+		Log("LOG: ACE: Compacted %s (%llu -> %llu bytes)", fmt_path.string().c_str(), (unsigned long long)old_size, (unsigned long long)new_size);
+		return 1;
+	}
+
+	int RegisterAtlas(const char* name, const char** tags, int count, int width, int height, int flags) {
+		if (s_atlas_baker == nullptr) {
+			Log(FUNCTION_ERROR("ERROR: ACE: Could not register atlas \"%s\"; call LS_EnableBaking() first!"), name);
+			return 0;
+		}
+		ace_atlas atlas{ name, {}, width, height, flags };
+		for (int i = 0; i < count; i++) {
+			atlas.tags.push_back(tags[i]);
+		}
+		s_atlases.push_back(std::move(atlas));
 		return 1;
 	}
 
+	void SetAtlasBaker(ace_atlas_baker baker, const char* type) {
+		s_atlas_baker = baker;
+		s_atlas_type = type;
+	}
+
 	bool CheckFileFormat(const char* fmt, const std::filesystem::path& path, std::string& buffer) {
 		std::stringstream ss(fmt);
 		while (std::getline(ss, buffer, ',')) {
@@ -458,17 +2147,130 @@ namespace ace {
 	}
 
 	ace_buffer LoadContentBuffer(const char* tags[], int count) {
+		ACE_TRACE_SCOPE("ace", "LoadContentBuffer", nullptr);
 		ace_buffer elements;
+		elements.reserve(count);
 		for (size_t i = 0; i < count; i++) {
-			ace_entry e = ace_iterator::Get()[tags[i]];
-			if (e.id != "") { elements.vector.push_back(e); }
+			std::shared_ptr<ace_iterator> archive = Resolve(tags[i]);
+			if (archive == nullptr) { continue; }
+			EX_ace_entry_cpp e = (*archive)[tags[i]];
+			if (e.id != "") { elements.emplace_back(std::make_shared<EX_ace_entry_cpp>(std::move(e))); }
 		}
 		return elements;
 	}
 
+	ace_buffer LoadContentArena(const char* tags[], int count) {
+		ACE_TRACE_SCOPE("ace", "LoadContentArena", nullptr);
+		std::vector<EX_ace_entry_cpp> entries;
+		std::vector<size_t> offsets;
+		unsigned char* strings = nullptr;
+		unsigned char* arena = LoadArena(tags, count, entries, offsets, false, strings);
+		return ShareArena(arena, entries, offsets);
+	}
+
+	ace_buffer LoadBundle(const char* name) {
+		ACE_TRACE_SCOPE("ace", "LoadBundle", name);
+		std::shared_ptr<ace_iterator> archive = ResolveBundle(name);
+		if (archive == nullptr) { return {}; }
+		std::vector<EX_ace_entry_cpp> entries;
+		std::vector<size_t> offsets;
+		unsigned char* strings = nullptr;
+		unsigned char* arena = archive->load_bundle(name, entries, offsets, false, strings);
+		return ShareArena(arena, entries, offsets);
+	}
+
 	ace_entry LoadContent(const char* tag) {
-		return ace_iterator::Get()[tag];
+		ACE_TRACE_SCOPE("ace", "LoadContent", tag);
+		std::shared_ptr<ace_iterator> archive = Resolve(tag);
+		if (archive == nullptr) { return nullptr; }
+		EX_ace_entry_cpp e = (*archive)[tag];
+		if (e.id == "") { return nullptr; }
+		return std::make_shared<EX_ace_entry_cpp>(std::move(e));
+	}
+
+	unsigned int ContentSize(const char* tag) {
+		std::shared_ptr<ace_iterator> archive = Resolve(tag);
+		return archive != nullptr ? archive->peek(tag).size : 0;
+	}
+
+	unsigned int LoadContentInto(const char* tag, void* buffer, unsigned int capacity) {
+		ACE_TRACE_SCOPE("ace", "LoadContentInto", tag);
+		std::shared_ptr<ace_iterator> archive = Resolve(tag);
+		return archive != nullptr ? archive->load_into(tag, buffer, capacity) : 0;
+	}
+
+	unsigned int ReadRange(const char* tag, unsigned int offset, unsigned int length, void* buffer) {
+		if (length == 0) { return 0; }
+		ACE_TRACE_SCOPE("ace", "ReadRange", tag);
+		std::shared_ptr<ace_iterator> archive = Resolve(tag);
+		return archive != nullptr ? archive->read_range(tag, offset, length, (unsigned char*)buffer) : 0;
+	}
+
+	int GetStats(ace_archive archive, ace_stats* stats) {
+#ifdef ACE_INSTRUMENT
+		std::shared_lock<std::shared_mutex> lock(s_mounts_mutex);
+		*stats = {};
+		bool found = false;
+		for (auto& mount : s_mounts) {
+			if (archive == ACE_INVALID_ARCHIVE || mount.handle == archive) {
+				mount.archive->add_stats(*stats);
+				found = true;
+			}
+		}
+		return found ? 1 : 0;
+#else
+		(void)archive;
+		*stats = {};
+		return 0;
+#endif
+	}
+
+	void ResetStats() {
+#ifdef ACE_INSTRUMENT
+		std::shared_lock<std::shared_mutex> lock(s_mounts_mutex);
+		for (auto& mount : s_mounts) { mount.archive->reset_stats(); }
+#endif
+	}
+
+	void StartTrace() {
+		trace::Start();
+	}
+
+	int StopTrace(const char* path) {
+		return trace::Stop(path) ? 1 : 0;
+	}
+}
+
+// Hands an entry's decompressed data over to C as is; only the strings are copied.
+static EX_ace_entry_c ToCEntry(EX_ace_entry_cpp& entry) {
+	EX_ace_entry_c c_entry = {};
+	c_entry.id = (const char*)malloc((entry.id.size() + 1) * sizeof(char));
+	memcpy((void*)c_entry.id, entry.id.c_str(), (entry.id.size() + 1) * sizeof(char));
+	c_entry.type = (const char*)malloc((entry.type.size() + 1) * sizeof(char));
+	memcpy((void*)c_entry.type, entry.type.c_str(), (entry.type.size() + 1) * sizeof(char));
+	c_entry.size = entry.size;
+	c_entry.data = entry.Release();	// Allocated by the reader; Ace_FreeEntry() frees it
+	return c_entry;
+}
+
+// Hands an arena over to C; ids & types are copied to 'strings', inside the arena.
+static EX_ace_buffer_c ToCArena(unsigned char* arena, std::vector<EX_ace_entry_cpp>& entries,
+	const std::vector<size_t>& offsets, unsigned char* strings) {
+	EX_ace_buffer_c c_buf = {};
+	c_buf.arena = arena;
+	if (c_buf.arena == NULL) { return c_buf; }
+	c_buf.buffer = (EX_ace_entry_c*)malloc(entries.size() * sizeof(EX_ace_entry_c));
+	c_buf.size = entries.size();
+	for (size_t i = 0; i < entries.size(); i++) {
+		EX_ace_entry_c& c_entry = c_buf.buffer[i];
+		c_entry.id = (const char*)memcpy(strings, entries[i].id.c_str(), entries[i].id.size() + 1);
+		strings += entries[i].id.size() + 1;
+		c_entry.type = (const char*)memcpy(strings, entries[i].type.c_str(), entries[i].type.size() + 1);
+		strings += entries[i].type.size() + 1;
+		c_entry.data = arena + offsets[i];
+		c_entry.size = entries[i].size;
 	}
+	return c_buf;
 }
 
 extern "C" {
@@ -484,52 +2286,151 @@ extern "C" {
 		return ace::Generate(compression_level, res_path, output_path, output_name);
 	}
 
+	int Ace_AppendContent(int compression_level, const char* res_path, const char* ace_path, const char* ace_name, const char* files[], int count) {
+		return ace::AppendContent(compression_level, res_path, ace_path, ace_name, files, count);
+	}
+
+	int Ace_Compact(const char* ace_path, const char* ace_name) {
+		return ace::Compact(ace_path, ace_name);
+	}
+
+	ace_archive Ace_Mount(const char* path, int priority) {
+		return ace::Mount(path, priority);
+	}
+
+	void Ace_Unmount(ace_archive archive) {
+		ace::Unmount(archive);
+	}
+
+	void Ace_SetAllocator(const ace_allocator* allocator) {
+		ace::SetAllocator(allocator);
+	}
+
+	void Ace_SetLog(FILE* stream) {
+		ace::SetLog(stream);
+	}
+
+	int Ace_RegisterAtlas(const char* name, const char** tags, int count, int width, int height, int flags) {
+		return ace::RegisterAtlas(name, tags, count, width, height, flags);
+	}
+
 	EX_ace_buffer_c Ace_LoadContentBuffer(const char* tags[], int count) {
 		ace_buffer ret = ace::LoadContentBuffer(tags, count);
-		EX_ace_buffer_c c_buf;
-		c_buf.buffer = (EX_ace_entry_c*)malloc(ret.vector.size() * sizeof(EX_ace_entry_c));
-		c_buf.size = ret.vector.size();
-		for (size_t i = 0; i < ret.vector.size(); i++) {
-			ace_entry entry = ret[i];
-			EX_ace_entry_c c_entry = {};
-			c_entry.id = (const char*)malloc((entry.id.size() + 1) * sizeof(char));
-			memcpy((void*)c_entry.id, entry.id.c_str(), (entry.id.size() + 1) * sizeof(char));
-			c_entry.type = (const char*)malloc((entry.type.size() + 1) * sizeof(char));
-			memcpy((void*)c_entry.type, entry.type.c_str(), (entry.type.size() + 1) * sizeof(char));
-			c_entry.data = (unsigned char*)malloc(entry.size);
-			memcpy((void*)c_entry.data, entry.data, entry.size);
-			c_entry.size = entry.size;
-			c_buf.buffer[i] = c_entry;
-		}
-		ret.Dispose();
+		EX_ace_buffer_c c_buf = {};
+		c_buf.buffer = (EX_ace_entry_c*)malloc(ret.size() * sizeof(EX_ace_entry_c));
+		c_buf.size = ret.size();
+		for (size_t i = 0; i < ret.size(); i++) {
+			c_buf.buffer[i] = ToCEntry(*ret[i]);
+		}
 		return c_buf;
 	}
 
+	EX_ace_buffer_c Ace_LoadContentArena(const char* tags[], int count) {
+		// Ids & types go into the arena too, after the data; it's the only allocation besides
+		// the entry array itself.
+		std::vector<EX_ace_entry_cpp> entries;
+		std::vector<size_t> offsets;
+		unsigned char* strings = nullptr;
+		unsigned char* arena = LoadArena(tags, count, entries, offsets, true, strings);
+		return ToCArena(arena, entries, offsets, strings);
+	}
+
+	EX_ace_buffer_c Ace_LoadBundle(const char* name) {
+		std::shared_ptr<ace_iterator> archive = ResolveBundle(name);
+		if (archive == nullptr) { return {}; }
+		std::vector<EX_ace_entry_cpp> entries;
+		std::vector<size_t> offsets;
+		unsigned char* strings = nullptr;
+		unsigned char* arena = archive->load_bundle(name, entries, offsets, true, strings);
+		return ToCArena(arena, entries, offsets, strings);
+	}
+
 	EX_ace_entry_c Ace_LoadContent(const char* tag) {
 		ace_entry entry = ace::LoadContent(tag);
-		EX_ace_entry_c c_entry = {};
-		if (entry.id != "") {
-			c_entry.id = (const char*)malloc((entry.id.size() + 1) * sizeof(char));
-			memcpy((void*)c_entry.id, entry.id.c_str(), (entry.id.size() + 1) * sizeof(char));
-			c_entry.type = (const char*)malloc((entry.type.size() + 1) * sizeof(char));
-			memcpy((void*)c_entry.type, entry.type.c_str(), (entry.type.size() + 1) * sizeof(char));
-			c_entry.data = (unsigned char*)malloc(entry.size);
-			memcpy((void*)c_entry.data, entry.data, entry.size);
-			c_entry.size = entry.size;
-		}
-		entry.Dispose();
-		return c_entry;
+		if (entry == nullptr) { return {}; }
+		return ToCEntry(*entry);
+	}
+
+	unsigned int Ace_ContentSize(const char* tag) {
+		return ace::ContentSize(tag);
+	}
+
+	unsigned int Ace_LoadContentInto(const char* tag, void* buffer, unsigned int capacity) {
+		return ace::LoadContentInto(tag, buffer, capacity);
+	}
+
+	void Ace_SetFrameSize(unsigned int frame_size) {
+		ace::SetFrameSize(frame_size);
+	}
+
+	void Ace_SetProfile(const char* path) {
+		ace::SetProfile(path);
+	}
+
+	void Ace_SetBundles(const char* path) {
+		ace::SetBundles(path);
+	}
+
+	void Ace_SetReadahead(unsigned int bytes) {
+		ace::SetReadahead(bytes);
+	}
+
+	void Ace_SetSolidBlocks(unsigned int entry_size, unsigned int block_size) {
+		ace::SetSolidBlocks(entry_size, block_size);
+	}
+
+	void Ace_SetBlockCache(unsigned int bytes) {
+		ace::SetBlockCache(bytes);
+	}
+
+	void Ace_SetVerify(int mode) {
+		ace::SetVerify(mode);
+	}
+
+	int Ace_Verify(const char* path) {
+		return ace::Verify(path);
+	}
+
+	void Ace_StartProfile() {
+		ace::StartProfile();
+	}
+
+	int Ace_StopProfile(const char* path) {
+		return ace::StopProfile(path);
+	}
+
+	unsigned int Ace_ReadRange(const char* tag, unsigned int offset, unsigned int length, void* buffer) {
+		return ace::ReadRange(tag, offset, length, buffer);
+	}
+
+	int Ace_GetStats(ace_archive archive, ace_stats* stats) {
+		return ace::GetStats(archive, stats);
+	}
+
+	void Ace_ResetStats() {
+		ace::ResetStats();
+	}
+
+	void Ace_StartTrace() {
+		ace::StartTrace();
+	}
+
+	int Ace_StopTrace(const char* path) {
+		return ace::StopTrace(path);
 	}
 
 	void Ace_FreeEntry(EX_ace_entry_c entry) {
-		free((void*)entry.data);
+		ace::Free(entry.data);
 		free((void*)entry.id);
 		free((void*)entry.type);
 	}
 
 	void Ace_FreeBuffer(EX_ace_buffer_c buffer) {
-		for (int i = 0; i < buffer.size; i++) {
-			Ace_FreeEntry(buffer.buffer[i]);
+		if (buffer.arena != NULL) { ace::Free(buffer.arena); }
+		else {
+			for (int i = 0; i < buffer.size; i++) {
+				Ace_FreeEntry(buffer.buffer[i]);
+			}
 		}
 		free(buffer.buffer);
 	}
@@ -1,5 +1,7 @@
 #pragma once
 #include "aceconfig.h"
+#include <stddef.h>
+#include <stdio.h>
 
 typedef struct {
 	const char* type;
@@ -11,8 +13,32 @@ typedef struct {
 typedef struct {
 	int size;
 	EX_ace_entry_c* buffer;
+	void* arena;	// Set by LoadContentArena(); holds every entry's data, id & type
 } EX_ace_buffer_c;
 
+typedef int ace_archive;	// Handle to a mounted ace file
+#define ACE_INVALID_ARCHIVE -1
+
+// SetVerify() modes
+#define ACE_VERIFY_OFF 0		// Entries are loaded as they are (default)
+#define ACE_VERIFY_FIRST_LOAD 1	// Each record is checked the first time it's read
+
+typedef struct {
+	void* (*alloc)(void* user, size_t size);
+	void (*free)(void* user, void* ptr);
+	void* user;		// Handed back to both hooks
+} EX_ace_allocator;
+
+typedef struct {
+	unsigned long long lookups;				// Tags looked up in the archive
+	unsigned long long misses;				// Lookups the archive didn't have the entry for
+	unsigned long long bytes_read;			// Compressed bytes read from the file
+	unsigned long long bytes_decompressed;
+	unsigned long long io_ns;				// Time spent seeking & reading the file
+	unsigned long long decompress_ns;		// Time spent in zstd
+	unsigned long long cache_hits;			// Loads served from memory, without reading the file
+} EX_ace_stats;
+
 #if defined (__cplusplus)
 #define EX_ACE_FUNCTION(x) x
 
@@ -21,36 +47,85 @@ typedef struct {
 #include <memory>
 #include <filesystem>
 
+namespace ace {
+	void* Alloc(size_t size);
+	void Free(void* ptr);
+}
+
+// Read-only view of an entry's data; stands in for std::span while ace builds as C++17.
+struct EX_ace_bytes_cpp {
+	const unsigned char* ptr;
+	size_t length;
+
+	const unsigned char* data() const { return ptr; }
+	size_t size() const { return length; }
+	bool empty() const { return length == 0; }
+	const unsigned char* begin() const { return ptr; }
+	const unsigned char* end() const { return ptr + length; }
+	unsigned char operator[](const size_t i) const { return ptr[i]; }
+};
+
+/* EX_ace_entry_cpp:
+	An entry and the decompressed data it owns. It can be moved but not copied, and frees its
+	data when destroyed; share it through 'ace_entry'. Entries loaded with LoadContentArena()
+	share their arena instead, which goes away along with the last of them.
+	*/
 struct EX_ace_entry_cpp {
 	std::string type;
 	std::string id;
 	unsigned int size;		// Byte-wise
 	unsigned char* data;	// Data array
+	std::shared_ptr<unsigned char> arena;	// Set for arena entries; 'data' points into it
 
 	EX_ace_entry_cpp() : type(""), id(""), size(0), data(nullptr) {};
-	void Dispose() {
-		if (data != nullptr) {
-			free(data);
+	EX_ace_entry_cpp(const EX_ace_entry_cpp&) = delete;
+	EX_ace_entry_cpp& operator=(const EX_ace_entry_cpp&) = delete;
+	EX_ace_entry_cpp(EX_ace_entry_cpp&& other) noexcept :
+		type(std::move(other.type)), id(std::move(other.id)), size(other.size), data(other.data), arena(std::move(other.arena)) {
+		other.data = nullptr;
+	}
+	EX_ace_entry_cpp& operator=(EX_ace_entry_cpp&& other) noexcept {
+		if (this != &other) {
+			Dispose();
+			type = std::move(other.type);
+			id = std::move(other.id);
+			size = other.size;
+			data = other.data;
+			arena = std::move(other.arena);
+			other.data = nullptr;
 		}
+		return *this;
 	}
-};
-
-struct EX_ace_buffer_cpp {
-	std::vector<EX_ace_entry_cpp> vector;
+	~EX_ace_entry_cpp() { Dispose(); }
 
+	// Frees the data ahead of time; safe to call more than once.
 	void Dispose() {
-		for (int i = vector.size(); i--;) {
-			vector[i].Dispose();
+		if (data != nullptr && arena == nullptr) {
+			ace::Free(data);
 		}
+		arena.reset();
+		data = nullptr;
+	}
+
+	// Hands the data over to the caller, to be freed with ace::Free(); NULL for arena entries,
+	// whose data can't outlive the arena.
+	unsigned char* Release() {
+		if (arena != nullptr) { return nullptr; }
+		unsigned char* released = data;
+		data = nullptr;
+		return released;
 	}
 
-	EX_ace_entry_cpp operator[](const int i) {
-		return vector[i];
+	EX_ace_bytes_cpp Bytes() const {
+		return { data, data != nullptr ? size : 0 };
 	}
 };
 
-typedef EX_ace_entry_cpp ace_entry;
-typedef EX_ace_buffer_cpp ace_buffer;
+typedef std::shared_ptr<EX_ace_entry_cpp> ace_entry;	// NULL when an entry couldn't be loaded
+typedef std::vector<ace_entry> ace_buffer;
+typedef EX_ace_bytes_cpp ace_bytes;
+typedef EX_ace_allocator ace_allocator;
+typedef EX_ace_stats ace_stats;
 
 namespace ace {
 #else
@@ -60,10 +135,29 @@ namespace ace {
 
 typedef EX_ace_entry_c ace_entry;
 typedef EX_ace_buffer_c ace_buffer;
+typedef EX_ace_allocator ace_allocator;
+typedef EX_ace_stats ace_stats;
 #endif
 
 #define EX_ACE_ENTRY ace_entry
 
+/* SetAllocator():
+	Routes the memory ace hands out (entry data & arenas) through custom hooks; entries are
+	freed through them as well;
+
+	* Allocator: the hooks to use; NULL goes back to malloc() & free();
+	* NOTE: call it before Init() and don't change it while entries are still alive.
+	*/
+void EX_ACE_FUNCTION(SetAllocator(const ace_allocator* allocator));
+
+/* SetLog():
+	Where ace writes its log & error lines;
+
+	* Stream: stdout by default; stderr keeps them apart from a program's own output, NULL
+	  silences ace.
+	*/
+void EX_ACE_FUNCTION(SetLog(FILE* stream));
+
 /* Init():
     Initializes ace static data.
 	
@@ -72,15 +166,35 @@ typedef EX_ace_buffer_c ace_buffer;
 	* Ace_path: path in which to search for a ace file during operations;
 	* Ace_name: name of the ace file;
 	* Returns: 1 on success, 0 on failure
-	* NOTE: Will format path as 'ace_path' / 'ace_name'.ace*.
+	* NOTE: Will format path as 'ace_path' / 'ace_name'.ace*; that file is mounted with
+	  priority 0, replacing the one mounted by a previous Init().
 	*/
 int EX_ACE_FUNCTION(Init(int default_compression_level, const char* res_path, const char* ace_path, const char* ace_name, bool scan_changes));
 
 /* Stop():
-	Cleans up static data;
+	Cleans up static data; every archive is unmounted;
 	*/
 void EX_ACE_FUNCTION(Stop());
 
+/* Mount():
+	Opens another ace file on top of the ones already mounted; loads go to the first archive
+	that has the entry, so patches & DLC can shadow entries of a base archive without it
+	being rebuilt. Only the archive's index is read, so this is cheap for large files;
+
+	* Path: path of the ace file;
+	* Priority: archives with a higher priority are searched first; the one mounted by Init()
+	  has priority 0; among equal priorities the latest mount wins;
+	* Returns: a handle to the archive, or ACE_INVALID_ARCHIVE if it couldn't be opened.
+	*/
+ace_archive EX_ACE_FUNCTION(Mount(const char* path, int priority));
+
+/* Unmount():
+	Closes a mounted archive; entries already loaded from it stay valid;
+
+	* Archive: a handle returned by Mount().
+	*/
+void EX_ACE_FUNCTION(Unmount(ace_archive archive));
+
 /* Generate():
 	Generates a new ace file using files inside 'res_path', and outputs it to the
 	formatted path " 'output_path' / 'output_name'.ace ";
@@ -94,6 +208,178 @@ void EX_ACE_FUNCTION(Stop());
 	*/
 int EX_ACE_FUNCTION(Generate(int compression_level, const char* res_path, const char* output_path, const char* output_name));
 
+/* AppendContent():
+	Adds files to an ace file made by Generate(), or replaces the entries they share a name
+	with, without rewriting it: they're compressed with the file's dictionary & written at its
+	end along with a new index, so only they are read & written. Replaced entries stay in the
+	file as dead space until Compact(); bundles follow their members to the new records;
+
+	* Compression level: as for Generate();
+	* Res_path: path the files are in. If they're the only changes to it since the file was
+	  made, the file's hash is brought up to date so that Init(..., scan_changes) doesn't
+	  regenerate the file over it; any other change (or different atlas registrations) still
+	  makes it regenerate;
+	* Ace_path, Ace_name: the ace file, as for Init();
+	* Files: names of the files inside 'res_path'; each becomes the entry named after it
+	  (file name without extension);
+	* Count: number of elements inside 'files';
+	* Returns: 1 on success, 0 on failure; the file is then left as it was.
+	* NOTE: files are never put into solid blocks & atlases aren't baked again. Archives
+	  already mounted keep loading what they loaded before; mount the file again.
+	*/
+int EX_ACE_FUNCTION(AppendContent(int compression_level, const char* res_path, const char* ace_path, const char* ace_name, const char* files[], int count));
+
+/* Compact():
+	Rewrites an ace file without the dead space AppendContent() leaves behind; records are
+	copied as they are, so nothing is compressed again;
+
+	* Ace_path, Ace_name: the ace file, as for Init();
+	* Returns: 1 on success, 0 on failure; the file is then left as it was.
+	* NOTE: unmount the file first.
+	*/
+int EX_ACE_FUNCTION(Compact(const char* ace_path, const char* ace_name));
+
+/* RegisterAtlas():
+	Registers an atlas to be baked by lsqueezer whenever the ace file is generated, be it
+	through Generate() or through Init() finding changes. It is stored as an entry named
+	'name' and can be loaded back with lsqueezer's RunBaked();
+
+	* Name: id of the baked entry; must not clash with any file inside 'res_path';
+	* Tags: ids(file names without extension) of the images to pack;
+	* Count: number of elements inside 'tags';
+	* Width, Height: size of the atlas;
+	* Flags: a combination of LS_Flags;
+	* Returns: 1 on success, 0 if nothing bakes atlases yet (see lsqueezer's EnableBaking()).
+	* NOTE: call it before Init()/Generate(). Registrations are part of the file's hash, so
+	  changing them makes Init(..., scan_changes) regenerate it. Generate() fails rather than
+	  leave registered atlases out.
+	*/
+int EX_ACE_FUNCTION(RegisterAtlas(const char* name, const char** tags, int count, int width, int height, int flags));
+
+/* SetFrameSize():
+	Makes Generate() split entries larger than 'frame_size' into frames of that many bytes,
+	each compressed on its own, so ReadRange() reaches any part of them without decompressing
+	what comes before it. Smaller frames compress slightly worse;
+
+	* Frame_size: uncompressed bytes per frame; 0 (the default) keeps every entry whole;
+	* NOTE: call it before Init()/Generate(). Framed entries still load whole as usual.
+	*/
+void EX_ACE_FUNCTION(SetFrameSize(unsigned int frame_size));
+
+/* StartProfile(), StopProfile():
+	Record which entries are loaded, in the order they're first loaded & when; StopProfile()
+	writes them to 'path', one "<microseconds> <tag>" line each. Record a cold start or a level
+	load, then hand the file to SetProfile();
+
+	* Returns: 1 if the profile was written, 0 if nothing was being recorded or the file
+	  couldn't be written.
+	*/
+void EX_ACE_FUNCTION(StartProfile());
+int EX_ACE_FUNCTION(StopProfile(const char* path));
+
+/* SetProfile():
+	Makes Generate() lay entries out in the order a profile lists them; the rest follow. Loads
+	that follow the profile then read the file front to back, and the reader reads ahead of
+	them (see SetReadahead());
+
+	* Path: a file written by StopProfile(); NULL to go back to directory order;
+	* NOTE: call it before Init()/Generate(). Keep the profile inside 'res_path' so that
+	  Init(..., scan_changes) regenerates the ace file when the profile changes.
+	*/
+void EX_ACE_FUNCTION(SetProfile(const char* path));
+
+/* SetBundles():
+	Makes Generate() store groups of entries that are loaded together (a level, a menu, a
+	character...) in one piece, so LoadBundle() can bring each group in at once. A manifest
+	lists the groups: a "[name]" line starts one, every line after it is the tag of a member;
+	lines starting with '#' are skipped;
+
+	* Path: the manifest; NULL to stop making bundles;
+	* NOTE: call it before Init()/Generate(). Keep the manifest inside 'res_path' so that
+	  Init(..., scan_changes) regenerates the ace file when it changes.
+	*/
+void EX_ACE_FUNCTION(SetBundles(const char* path));
+
+/* SetReadahead():
+	How much of an archive laid out from a profile is read at once; loads of the entries that
+	follow are served from memory;
+
+	* Bytes: size of the window, 256 KiB by default; 0 reads each entry on its own.
+	*/
+void EX_ACE_FUNCTION(SetReadahead(unsigned int bytes));
+
+/* SetSolidBlocks():
+	Makes Generate() pack small entries (configs, icons, short sounds...) into shared blocks,
+	one being filled per file extension, each compressed as a whole: small entries compress
+	far better together than one by one, and loading one brings its neighbors in. The reader
+	keeps recently used blocks decompressed (see SetBlockCache()), so their other members load
+	from memory;
+
+	* Entry_size: entries of up to this many bytes go into blocks; 0 (the default) keeps every
+	  entry on its own;
+	* Block_size: uncompressed bytes per block; 0 for 64 KiB;
+	* NOTE: call it before Init()/Generate(). Bundle members are never put into blocks.
+	*/
+void EX_ACE_FUNCTION(SetSolidBlocks(unsigned int entry_size, unsigned int block_size));
+
+/* SetBlockCache():
+	How many bytes of decompressed solid blocks (see SetSolidBlocks()) each archive keeps;
+	the least recently used go first;
+
+	* Bytes: 1 MiB by default; 0 decompresses a block again for every member loaded from it.
+	*/
+void EX_ACE_FUNCTION(SetBlockCache(unsigned int bytes));
+
+/* SetVerify():
+	Whether loads check entries against the checksums Generate() stores for each of them (over
+	the whole record, header included), so a damaged file fails to load rather than handing out
+	garbage. A record is only checked the
+	first time it's read, so the cost is one pass of a fast hash over what's loaded;
+
+	* Mode: ACE_VERIFY_OFF (the default) or ACE_VERIFY_FIRST_LOAD;
+	* NOTE: ReadRange() only checks entries it reads whole (see SetFrameSize()). Files made
+	  before checksums were stored load unchecked.
+	*/
+void EX_ACE_FUNCTION(SetVerify(int mode));
+
+/* Verify():
+	Checks every record of an ace file against its checksum, e.g. once it's installed or
+	downloaded; the file is read front to back by several threads at once, without
+	decompressing anything. Corrupt entries are logged;
+
+	* Path: the ace file; it doesn't need to be mounted;
+	* Returns: 1 if every record matches, 0 if any doesn't, the file couldn't be read or it has
+	  no checksums.
+	*/
+int EX_ACE_FUNCTION(Verify(const char* path));
+
+/* GetStats():
+	Counters of a mounted archive since it was mounted or since ResetStats(); only kept when
+	ACE_INSTRUMENT is defined (see aceconfig.h). A tag missing from every archive counts as a
+	miss in each of them;
+
+	* Archive: a handle returned by Mount(), or ACE_INVALID_ARCHIVE for the sum of every
+	  mounted archive (the one mounted by Init() included);
+	* Stats: receives the counters;
+	* Returns: 1 on success, 0 if the archive isn't mounted or instrumentation is compiled out.
+	*/
+int EX_ACE_FUNCTION(GetStats(ace_archive archive, ace_stats* stats));
+
+/* ResetStats():
+	Zeroes the counters of every mounted archive.
+	*/
+void EX_ACE_FUNCTION(ResetStats());
+
+/* StartTrace(), StopTrace():
+	Capture trace spans of ace's loads, Generate() & lsqueezer's builds, from every thread;
+	StopTrace() writes them to 'path' as Chrome trace JSON (chrome://tracing, Perfetto);
+
+	* Returns: 1 if the trace was written, 0 if nothing was being captured, the file couldn't
+	  be written or instrumentation is compiled out.
+	*/
+void EX_ACE_FUNCTION(StartTrace());
+int EX_ACE_FUNCTION(StopTrace(const char* path));
+
 #ifdef __cplusplus
 #endif
 
@@ -112,11 +398,78 @@ ace_buffer EX_ACE_FUNCTION(LoadContentBuffer(const char* tags[], int count));
 	*/
 EX_ACE_ENTRY EX_ACE_FUNCTION(LoadContent(const char* tag));
 
+/* LoadContentArena():
+	Same as LoadContentBuffer(), but every entry is decompressed back to back into a single
+	allocation sized up front, which is released in one go: once the last entry is gone in
+	C++, through FreeBuffer() in C;
+
+	* Tags: array of tags(ids) to look for inside the ace file;
+	* Count: number of elements inside 'tags'.
+	*/
+ace_buffer EX_ACE_FUNCTION(LoadContentArena(const char* tags[], int count));
+
+/* LoadBundle():
+	Loads every member of a bundle (see SetBundles()) with a single read, decompressing them in
+	parallel into one allocation that's released in one go, like LoadContentArena(). Members
+	come in manifest order, and are all taken from the first archive that has the bundle;
+
+	* Name: the bundle's name inside the manifest.
+	*/
+ace_buffer EX_ACE_FUNCTION(LoadBundle(const char* name));
+
+/* ContentSize():
+	Size of an entry once decompressed; only its header is read (or its solid block, see
+	SetSolidBlocks()), so use it to size the buffer given to LoadContentInto();
+
+	* Tag: a tag(id) to look for inside the ace file;
+	* Returns: the size in bytes, or 0 if the entry doesn't exist.
+	*/
+unsigned int EX_ACE_FUNCTION(ContentSize(const char* tag));
+
+/* LoadContentInto():
+	Decompresses an entry straight into a buffer owned by the caller; nothing is allocated
+	for the data;
+
+	* Tag: a tag(id) to look for inside the ace file;
+	* Buffer, Capacity: where to write the data & its size in bytes;
+	* Returns: the number of bytes written, or 0 if the entry doesn't exist or doesn't fit.
+	*/
+unsigned int EX_ACE_FUNCTION(LoadContentInto(const char* tag, void* buffer, unsigned int capacity));
+
+/* ReadRange():
+	Decompresses part of an entry into a buffer owned by the caller. Only the frames the range
+	touches are decompressed (see SetFrameSize()); entries without frames are decompressed from
+	their start up to the end of the range;
+
+	* Tag: a tag(id) to look for inside the ace file;
+	* Offset, Length: the range to read, in bytes from the start of the entry;
+	* Buffer: where to write the data; at least 'length' bytes;
+	* Returns: the number of bytes written; less than 'length' if the range goes past the end
+	  of the entry, 0 if the entry doesn't exist.
+	*/
+unsigned int EX_ACE_FUNCTION(ReadRange(const char* tag, unsigned int offset, unsigned int length, void* buffer));
+
 #ifdef __cplusplus
 // Internal usage
+bool UsesDefaultAllocator();
 bool CheckFileFormat(const char* fmt, const std::filesystem::path& path, std::string& buffer);
+
+/* SetAtlasBaker():
+	Sets what Generate() bakes registered atlases (see RegisterAtlas()) with; lsqueezer's
+	EnableBaking() sets it, so ace doesn't depend on lsqueezer;
+
+	* Baker: packs 'entries' into a 'width' x 'height' atlas & serializes it; returns an empty
+	  vector on failure;
+	* Type: type of the baked entries.
+	*/
+typedef std::vector<unsigned char> (*ace_atlas_baker)(ace_buffer& entries, int width, int height, int flags);
+void SetAtlasBaker(ace_atlas_baker baker, const char* type);
 }
 #else
+/* FreeEntry(), FreeBuffer():
+	Free what LoadContent(), LoadContentBuffer(), LoadContentArena() & LoadBundle() return;
+	entries own the decompressed data handed over by ace, so no copy is made when loading them.
+	*/
 void EX_ACE_FUNCTION(FreeEntry(ace_entry entry));
 void EX_ACE_FUNCTION(FreeBuffer(ace_buffer buffer));
 #endif
@@ -84,3 +84,9 @@
 #endif
 #pragma endregion
 #define ACE_SUPPORTED_SND_FILEFORMATS SND_WAV_MP3 SND_FLAC SND_MOD SND_OGG SND_XM
+
+/* Runtime instrumentation: per-archive counters (see GetStats()), lsqueezer's time per phase
+	and trace spans exported as Chrome trace JSON (see trace.h). Left undefined, all of it
+	compiles to nothing; define it here or in the build to capture load hitches.
+	*/
+// #define ACE_INSTRUMENT
@@ -152,6 +152,64 @@ Rect MaxRectsBinPack::ScoreRect(int width, int height, FreeRectChoiceHeuristic m
 	return newNode;
 }
 
+void MaxRectsBinPack::Free(const Rect &rect)
+{
+	for(size_t i = 0; i < usedRectangles.size(); ++i)
+		if (usedRectangles[i].x == rect.x && usedRectangles[i].y == rect.y &&
+			usedRectangles[i].width == rect.width && usedRectangles[i].height == rect.height)
+		{
+			usedRectangles[i] = usedRectangles.back();
+			usedRectangles.pop_back();
+			break;
+		}
+
+	// The freed area alone is rarely maximal. Grow it over free rectangles that share a whole
+	// edge with it, so the space can be used by rectangles larger than the one freed.
+	Rect freed = rect;
+	bool merged = true;
+	while(merged)
+	{
+		merged = false;
+		for(size_t i = 0; i < freeRectangles.size(); ++i)
+		{
+			const Rect &f = freeRectangles[i];
+			Rect grown = freed;
+			if (f.y == freed.y && f.height == freed.height && (f.x + f.width == freed.x || freed.x + freed.width == f.x))
+			{
+				grown.x = min(f.x, freed.x);
+				grown.width = f.width + freed.width;
+			}
+			else if (f.x == freed.x && f.width == freed.width && (f.y + f.height == freed.y || freed.y + freed.height == f.y))
+			{
+				grown.y = min(f.y, freed.y);
+				grown.height = f.height + freed.height;
+			}
+			else
+				continue;
+
+			freed = grown;
+			merged = true;
+			break;
+		}
+	}
+
+	// Keep the free list free of contained rectangles, like PruneFreeList does.
+	for(size_t i = 0; i < freeRectangles.size(); ++i)
+		if (IsContainedIn(freed, freeRectangles[i]))
+			return;
+	for(size_t i = 0; i < freeRectangles.size();)
+	{
+		if (IsContainedIn(freeRectangles[i], freed))
+		{
+			freeRectangles[i] = freeRectangles.back();
+			freeRectangles.pop_back();
+		}
+		else
+			++i;
+	}
+	freeRectangles.push_back(freed);
+}
+
 /// Computes the ratio of used surface area.
 double MaxRectsBinPack::Occupancy() const
 {
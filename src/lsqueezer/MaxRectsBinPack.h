@@ -48,6 +48,10 @@ public:
 	/// Inserts a single rectangle into the bin, possibly rotated.
 	Rect Insert(int width, int height, FreeRectChoiceHeuristic method);
 
+	/// Returns a previously inserted rectangle to the free space, so it can be reused by later inserts.
+	/// @param rect The rectangle exactly as returned by Insert.
+	void Free(const Rect &rect);
+
 	/// Computes the ratio of used surface area to the total bin area.
 	double Occupancy() const;
 
@@ -0,0 +1,269 @@
+#include "atlas_builder.h"
+#include "Rect.h"
+#include "MaxRectsBinPack.h"
+#include "pixel_ops.h"
+#include "block_encoder.h"
+#include "../trace.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unordered_map>
+#include <assert.h>
+
+#define STB_IMAGE_STATIC	// raylib carries its own copy
+#define STB_IMAGE_IMPLEMENTATION
+#include "external/stb_image.h"
+
+namespace ls {
+
+// Block-compressed atlases are packed & blitted as RGBA8, then encoded as a whole.
+static bool IsBlockFormat(const int flags) {
+	return (flags & LS_FORMAT_MASK) >= LS_FORMAT_BC1;
+}
+
+static Format OutputFormat(const int flags) {
+	if (IsBlockFormat(flags)) { return Format::RGBA8; }
+	return (Format)((flags & LS_FORMAT_MASK) >> 8);	// LS_FORMAT_* follow ls::Format's order
+}
+
+static BlockFormat OutputBlockFormat(const int flags) {
+	return (BlockFormat)(((flags & LS_FORMAT_MASK) - LS_FORMAT_BC1) >> 8);	// Same order as ls::BlockFormat
+}
+
+static int AlignToBlock(const int size) {
+	return (size + 3) & ~3;
+}
+
+#ifdef ACE_INSTRUMENT
+static std::atomic<uint64_t> s_builds(0);
+static std::atomic<uint64_t> s_prepare_ns(0);
+static std::atomic<uint64_t> s_pack_ns(0);
+static std::atomic<uint64_t> s_blit_ns(0);
+static std::atomic<uint64_t> s_encode_ns(0);
+#endif
+
+Stats GetStats() {
+#ifdef ACE_INSTRUMENT
+	return { s_builds, s_prepare_ns, s_pack_ns, s_blit_ns, s_encode_ns };
+#else
+	return {};
+#endif
+}
+
+void ResetStats() {
+#ifdef ACE_INSTRUMENT
+	s_builds = 0;
+	s_prepare_ns = 0;
+	s_pack_ns = 0;
+	s_blit_ns = 0;
+	s_encode_ns = 0;
+#endif
+}
+
+size_t PageSize(int width, int height, int format) {
+	if (IsBlockFormat(format)) { return EncodedSize(width, height, OutputBlockFormat(format)); }
+	return (size_t)width * height * BytesPerPixel(OutputFormat(format));
+}
+
+bool ReadImageSize(const unsigned char* data, size_t size, int& width, int& height) {
+	auto be32 = [](const unsigned char* p) { return (int)((uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3]); };
+	int32_t le[3];
+	if (size >= 24 && memcmp(data, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(data + 12, "IHDR", 4) == 0) {
+		width = be32(data + 16);
+		height = be32(data + 20);
+	}
+	else if (size >= 14 && memcmp(data, "qoif", 4) == 0) {
+		width = be32(data + 4);
+		height = be32(data + 8);
+	}
+	else if (size >= 26 && memcmp(data, "BM", 2) == 0) {
+		memcpy(le, data + 14, sizeof(le));	// Info header size, width, height
+		if (le[0] < 40) { return false; }
+		width = le[1];
+		height = le[2] < 0 ? -le[2] : le[2];	// Negative heights are top-down bitmaps
+	}
+	else { return false; }
+	return width > 0 && height > 0;
+}
+
+bool DecodeImage(const unsigned char* data, size_t size, Bitmap& out) {
+	int channels = 0;
+	free(out.pixels);
+	out.pixels = stbi_load_from_memory(data, (int)size, &out.width, &out.height, &channels, 4);
+	return out.pixels != nullptr;
+}
+
+bool BuildAtlas(const Source& source, const Settings& settings, Page& page,
+	std::vector<AtlasComponent>& components, std::vector<bool>& loaded) {
+	ACE_TRACE_SCOPE("lsqueezer", "BuildAtlas", nullptr);
+	ACE_STAT_ADD(s_builds, 1);
+	const bool verbose = settings.verbose;
+	if (verbose) { puts("LSQUEEZER: Generating & populating buffers"); }
+	const bool allow_rotation = (settings.flags & LS_FLAG_ALLOW_ROTATION) != 0;
+	const bool trim = (settings.flags & LS_FLAG_TRIM) != 0;
+	const Format format = OutputFormat(settings.flags);
+	const bool block = IsBlockFormat(settings.flags);
+	if (block && (settings.width % 4 != 0 || settings.height % 4 != 0)) {
+		puts("ERROR AT " __FUNCTION__ ": Block-compressed atlases need a size that is a multiple of 4. Aborting.");
+		return false;
+	}
+	// Untrimmed sources that know their sizes: nothing is decoded before packing.
+	const bool header_sizes = source.size && !trim;
+
+	// Images whose (trimmed) pixels match an earlier image reuse its rect; 'owner[i] == i' otherwise.
+	const size_t missing = (size_t)-1;
+	std::vector<rbp::Rect> sources;
+	std::vector<rbp::RectSize> originals;
+	std::vector<size_t> owner;
+	std::vector<size_t> packed;	// Images that get their own rect, in packing order
+	std::vector<rbp::RectSize> dimensions;
+	std::unordered_multimap<uint64_t, size_t> hashes;
+	{
+		ACE_TRACE_SCOPE("lsqueezer", "prepare", nullptr);
+		ACE_STAT_TIME(s_prepare_ns);
+		auto pack_entry = [&](size_t i, const rbp::Rect& src) {
+			rbp::RectSize rs = { src.width, src.height };
+			if (block) {
+				// Whole blocks only: positions stay 4-aligned & neighbours never share a block.
+				rs.width = AlignToBlock(rs.width);
+				rs.height = AlignToBlock(rs.height);
+			}
+			packed.push_back(i);
+			dimensions.push_back(rs);
+		};
+		for (size_t i = 0; i < source.count; i++) {
+			owner.push_back(i);
+			int width = 0, height = 0;
+			if (header_sizes && source.size(i, width, height)) {
+				sources.push_back({ 0, 0, width, height });
+				originals.push_back({ width, height });
+				pack_entry(i, sources[i]);
+				continue;
+			}
+
+			Bitmap img;
+			if (!source.decode(i, img)) {
+				printf("ERROR AT " __FUNCTION__ ": Could not load image (%s); skipping it\n", source.name(i));
+				sources.push_back({ 0, 0, 0, 0 });
+				originals.push_back({ 0, 0 });
+				owner[i] = missing;
+				continue;
+			}
+			rbp::Rect src = PackedRegion(img.pixels, img.width, img.height, trim);
+			sources.push_back(src);
+			originals.push_back({ img.width, img.height });
+
+			const uint64_t hash = HashPixels(img.pixels, img.width, src);
+			auto range = hashes.equal_range(hash);
+			for (auto it = range.first; it != range.second && owner[i] == i; ++it) {
+				Bitmap other;
+				if (source.decode(it->second, other) &&
+					PixelsEqual(img.pixels, img.width, src, other.pixels, other.width, sources[it->second])) {
+					owner[i] = it->second;
+					if (verbose) { printf("LSQUEEZER: (%s) is identical to (%s); sharing its rect\n", source.name(i), source.name(it->second)); }
+				}
+			}
+			if (owner[i] == i) {
+				hashes.emplace(hash, i);
+				pack_entry(i, src);
+			}
+		}
+	}
+
+	float best_occupancy = 0.0f;
+	std::vector<rbp::Rect> rects;
+	for (char method = 0; method < 5; method++) {
+		ACE_TRACE_SCOPE("lsqueezer", "pack", nullptr);
+		ACE_STAT_TIME(s_pack_ns);
+		// TODO: Move to Guilloutine Packer.
+		rbp::MaxRectsBinPack pack(settings.width, settings.height, allow_rotation);
+		std::vector<rbp::Rect> out;
+
+		double occupancy = 0;
+		if (verbose) { printf("LSQUEEZER: Calculating occupancy using method #%d\n", method); }
+		for (size_t i = 0; i < dimensions.size(); i++) {
+			rbp::RectSize& rs = dimensions[i];
+			rbp::Rect r = pack.Insert(rs.width, rs.height, (rbp::MaxRectsBinPack::FreeRectChoiceHeuristic)method);
+			if (r.height == 0) { break; }
+			out.push_back(r);
+		}
+
+		if (out.size() != dimensions.size()) {
+			if (verbose) { printf("LSQUEEZER: Method #%d could not fit every entry\n", method); }
+			continue;
+		}
+
+		occupancy = pack.Occupancy();
+		if (verbose) { printf("LSQUEEZER: Occupancy of method #%d: %.02f\n", method, occupancy); }
+		if (occupancy > best_occupancy) {
+			best_occupancy = occupancy;
+			rects.swap(out);
+		}
+	}
+
+	if (best_occupancy <= 0) {
+		puts("ERROR AT " __FUNCTION__ ": Atlas size too small. Aborting.");
+		return false;
+	}
+
+	if (verbose) { puts("LSQUEEZER: Populating bin"); }
+	// Zeroed memory is transparent in every output format.
+	unsigned char* bin = (unsigned char*)calloc((size_t)settings.width * settings.height, BytesPerPixel(format));
+	std::vector<rbp::Rect> placement(source.count);
+	std::vector<bool> placed_rotated(source.count);
+	{
+		ACE_TRACE_SCOPE("lsqueezer", "blit", nullptr);
+		ACE_STAT_TIME(s_blit_ns);
+		for (size_t k = 0; k < packed.size(); k++) {
+			const size_t i = packed[k];
+			Bitmap img;
+			if (!source.decode(i, img)) {
+				// Sized from its header (see 'header_sizes') but undecodable: neither it nor the
+				// images sharing its rect get a component.
+				printf("ERROR AT " __FUNCTION__ ": Could not load image (%s); skipping it\n", source.name(i));
+				for (size_t j = 0; j < source.count; j++) {
+					if (owner[j] == i) { owner[j] = missing; }
+				}
+				continue;
+			}
+			rbp::Rect& src = sources[i];
+			rbp::Rect& r = rects[k];
+			const rbp::RectSize& rs = dimensions[k];
+			const bool rotated = r.width != rs.width;
+			assert(r.width == (rotated ? rs.height : rs.width));
+			assert(r.height == (rotated ? rs.width : rs.height));
+			if (verbose) { printf("LSQUEEZER: Copying image (%s) to bin%s\n", source.name(i), rotated ? " (rotated)" : ""); }
+			BlitConverted(bin, settings.width, img.pixels, img.width, src, r.x, r.y, rotated, format);
+			placement[i] = r;
+			placed_rotated[i] = rotated;
+		}
+	}
+
+	if (block) {
+		ACE_TRACE_SCOPE("lsqueezer", "encode", nullptr);
+		ACE_STAT_TIME(s_encode_ns);
+		const BlockFormat block_format = OutputBlockFormat(settings.flags);
+		if (verbose) { puts("LSQUEEZER: Block-compressing bin"); }
+		unsigned char* encoded = (unsigned char*)malloc(EncodedSize(settings.width, settings.height, block_format));
+		EncodeBlocks(bin, settings.width, settings.height, encoded, block_format, settings.threads);
+		free(bin);
+		bin = encoded;
+	}
+
+	components.assign(source.count, AtlasComponent{ 0 });
+	loaded.assign(source.count, false);
+	for (size_t i = 0; i < source.count; i++) {
+		if (owner[i] == missing) { continue; }
+		// Aliases keep their own trim offsets; only the rect is shared.
+		const rbp::Rect& src = sources[i];
+		const rbp::Rect& r = placement[owner[i]];
+		const bool rotated = placed_rotated[owner[i]];
+		components[i] = { src.width, src.height, r.x, r.y, (float)src.x, (float)src.y,
+			originals[i].width, originals[i].height, rotated };
+		loaded[i] = true;
+	}
+	page = { bin, settings.width, settings.height, settings.flags & LS_FORMAT_MASK };
+	return true;
+}
+
+}
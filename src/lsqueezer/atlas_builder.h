@@ -0,0 +1,109 @@
+/* atlas_builder.*: lsqueezer's trimming, deduplication, packing & blitting on plain pixel buffers.
+	Nothing in here touches raylib or ace, so atlases can be built on headless machines; builds share
+	no state, so any number of them can run in parallel. lsqueezer is the raylib/ace front-end.
+	*/
+#pragma once
+#include "ls_flags.h"
+#include "../AtlasComponent.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <functional>
+#include <vector>
+
+namespace ls {
+
+/* Bitmap:
+	RGBA8 pixels allocated with malloc(); they're freed along with the bitmap.
+	*/
+struct Bitmap {
+	unsigned char* pixels = nullptr;
+	int width = 0;
+	int height = 0;
+
+	Bitmap() = default;
+	Bitmap(const Bitmap&) = delete;
+	Bitmap& operator=(const Bitmap&) = delete;
+	~Bitmap() { free(pixels); }
+};
+
+/* Source:
+	The images to pack. They're only reached through these callbacks, a couple at a time, so a
+	source can load them lazily and keep nothing around.
+	*/
+struct Source {
+	size_t count = 0;
+	std::function<const char*(size_t)> name;		// Used in logs
+	std::function<bool(size_t, Bitmap&)> decode;	// False if the image can't be loaded
+
+	// Optional: an image's size without decoding it. Untrimmed builds then decode each image
+	// once, right before blitting it, but identical images are no longer shared.
+	std::function<bool(size_t, int&, int&)> size;
+};
+
+/* Settings:
+	Size & flags of the page to build.
+	*/
+struct Settings {
+	int width;
+	int height;
+	int flags;		// LS_Flags
+	bool verbose;
+	int threads;	// Block encoder workers (LS_FORMAT_BC1/BC3/ETC2); 0 uses every hardware thread
+};
+
+/* Page:
+	A built atlas; 'pixels' is allocated with malloc() & owned by the caller.
+	*/
+struct Page {
+	unsigned char* pixels;
+	int width;
+	int height;
+	int format;		// One of the LS_FORMAT_* flags
+};
+
+/* BuildAtlas():
+	Packs every image of a source into a single page.
+
+	* Components: receives a component per image, in source order;
+	* Loaded: 'false' for images that couldn't be loaded; their components are zeroed;
+	* Returns: false if the images don't fit, or the size doesn't suit a block format.
+	*/
+bool BuildAtlas(const Source& source, const Settings& settings, Page& page,
+	std::vector<AtlasComponent>& components, std::vector<bool>& loaded);
+
+/* Stats:
+	Time BuildAtlas() spent in each phase, in nanoseconds, summed over every build since the
+	last ResetStats(); only kept when ACE_INSTRUMENT is defined (see trace.h).
+	*/
+struct Stats {
+	uint64_t builds;
+	uint64_t prepare_ns;	// Decoding, trimming & finding duplicates
+	uint64_t pack_ns;		// Trying every MaxRects heuristic
+	uint64_t blit_ns;		// Decoding again & copying into the page
+	uint64_t encode_ns;		// Block compression
+};
+
+/* GetStats(), ResetStats():
+	Read & zero the counters of every build, from any thread.
+	*/
+Stats GetStats();
+void ResetStats();
+
+/* PageSize():
+	Size in bytes of a 'width' x 'height' page in 'format' (LS_FORMAT_*).
+	*/
+size_t PageSize(int width, int height, int format);
+
+/* ReadImageSize():
+	Reads an encoded image's size from its header; PNG, QOI & BMP only.
+	*/
+bool ReadImageSize(const unsigned char* data, size_t size, int& width, int& height);
+
+/* DecodeImage():
+	Decodes an encoded image (any format stb_image reads) into RGBA8; for sources that don't
+	have raylib around.
+	*/
+bool DecodeImage(const unsigned char* data, size_t size, Bitmap& out);
+
+}
@@ -0,0 +1,501 @@
+#include "block_encoder.h"
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace ls {
+
+// A 4x4 block of RGBA8 pixels, row-major.
+struct Block {
+	unsigned char px[16][4];
+};
+
+static inline int Clamp255(int v) { return v < 0 ? 0 : (v > 255 ? 255 : v); }
+
+static inline int RoundDiv(int n, int d) { return n >= 0 ? (n + d / 2) / d : -((-n + d / 2) / d); }
+
+/*** BC1 / BC3 color ***/
+
+static inline int Expand5(int v) { return (v << 3) | (v >> 2); }
+static inline int Expand6(int v) { return (v << 2) | (v >> 4); }
+
+static inline uint16_t To565(const int c[3]) {
+	return (uint16_t)(((c[0] * 31 + 127) / 255) << 11 | ((c[1] * 63 + 127) / 255) << 5 | ((c[2] * 31 + 127) / 255));
+}
+
+static inline void From565(uint16_t v, int c[3]) {
+	c[0] = Expand5(v >> 11);
+	c[1] = Expand6((v >> 5) & 63);
+	c[2] = Expand5(v & 31);
+}
+
+static inline uint32_t PackRGB(const int c[3]) { return (uint32_t)(c[0] | c[1] << 8 | c[2] << 16); }
+
+// Picks the closest palette color for every pixel; returns the squared error over the 'used' pixels.
+// Ties go to the lower index.
+static uint32_t SelectIndices(const Block& block, const uint32_t palette[4], unsigned int used, unsigned char indices[16]) {
+	uint32_t error = 0;
+#ifdef LS_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	for (int q = 0; q < 4; q++) {
+		const __m128i px = _mm_and_si128(_mm_loadu_si128((const __m128i*)block.px[q * 4]), _mm_set1_epi32(0x00FFFFFF));
+		__m128i best = _mm_set1_epi32(INT32_MAX);
+		__m128i best_index = zero;
+		for (int p = 0; p < 4; p++) {
+			const __m128i c = _mm_set1_epi32((int)palette[p]);
+			const __m128i d = _mm_or_si128(_mm_subs_epu8(px, c), _mm_subs_epu8(c, px));
+			const __m128i lo = _mm_unpacklo_epi8(d, zero);
+			const __m128i hi = _mm_unpackhi_epi8(d, zero);
+			// (r² + g², b²) per pixel -> fold the pairs and gather the 4 sums in order.
+			__m128i s_lo = _mm_madd_epi16(lo, lo);
+			__m128i s_hi = _mm_madd_epi16(hi, hi);
+			s_lo = _mm_shuffle_epi32(_mm_add_epi32(s_lo, _mm_srli_epi64(s_lo, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+			s_hi = _mm_shuffle_epi32(_mm_add_epi32(s_hi, _mm_srli_epi64(s_hi, 32)), _MM_SHUFFLE(3, 1, 2, 0));
+			const __m128i dist = _mm_unpacklo_epi64(s_lo, s_hi);
+			const __m128i closer = _mm_cmplt_epi32(dist, best);
+			best = _mm_or_si128(_mm_and_si128(closer, dist), _mm_andnot_si128(closer, best));
+			best_index = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, best_index));
+		}
+		int32_t dists[4], idx[4];
+		_mm_storeu_si128((__m128i*)dists, best);
+		_mm_storeu_si128((__m128i*)idx, best_index);
+		for (int i = 0; i < 4; i++) {
+			indices[q * 4 + i] = (unsigned char)idx[i];
+			if (used >> (q * 4 + i) & 1) { error += (uint32_t)dists[i]; }
+		}
+	}
+#else
+	for (int i = 0; i < 16; i++) {
+		uint32_t best = UINT32_MAX;
+		for (int p = 0; p < 4; p++) {
+			uint32_t dist = 0;
+			for (int ch = 0; ch < 3; ch++) {
+				const int d = (int)block.px[i][ch] - (int)(palette[p] >> (8 * ch) & 0xFF);
+				dist += (uint32_t)(d * d);
+			}
+			if (dist < best) { best = dist; indices[i] = (unsigned char)p; }
+		}
+		if (used >> i & 1) { error += best; }
+	}
+#endif
+	return error;
+}
+
+// Bounding box of the 'used' pixels, inset a little, with its diagonal picked from the sign of each
+// channel's covariance with green. Integer only, like the classic real-time DXT encoders.
+static bool BoxEndpoints(const Block& block, unsigned int used, int c0[3], int c1[3]) {
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+	if (used == 0) { return false; }
+	for (int i = 0; i < 16; i++) {
+		if (!(used >> i & 1)) { continue; }
+		for (int ch = 0; ch < 3; ch++) {
+			lo[ch] = std::min(lo[ch], (int)block.px[i][ch]);
+			hi[ch] = std::max(hi[ch], (int)block.px[i][ch]);
+		}
+	}
+
+	int cov_rg = 0, cov_bg = 0;
+	for (int i = 0; i < 16; i++) {
+		if (!(used >> i & 1)) { continue; }
+		const int dg = 2 * block.px[i][1] - (lo[1] + hi[1]);
+		cov_rg += (2 * block.px[i][0] - (lo[0] + hi[0])) * dg;
+		cov_bg += (2 * block.px[i][2] - (lo[2] + hi[2])) * dg;
+	}
+
+	for (int ch = 0; ch < 3; ch++) {
+		const int inset = (hi[ch] - lo[ch]) >> 4;
+		c0[ch] = hi[ch] - inset;
+		c1[ch] = lo[ch] + inset;
+	}
+	if (cov_rg < 0) { std::swap(c0[0], c1[0]); }
+	if (cov_bg < 0) { std::swap(c0[2], c1[2]); }
+	return true;
+}
+
+// Least-squares endpoints for a fixed set of 4-color indices.
+static bool RefitEndpoints(const Block& block, unsigned int used, const unsigned char indices[16], int c0[3], int c1[3]) {
+	static const int kWeight[4] = { 3, 0, 2, 1 };	// Weight of c0, in thirds, for each index
+	int aa = 0, ab = 0, bb = 0;
+	int xa[3] = { 0, 0, 0 }, xb[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++) {
+		if (!(used >> i & 1)) { continue; }
+		const int a = kWeight[indices[i]], b = 3 - a;
+		aa += a * a; ab += a * b; bb += b * b;
+		for (int ch = 0; ch < 3; ch++) {
+			xa[ch] += 3 * a * block.px[i][ch];
+			xb[ch] += 3 * b * block.px[i][ch];
+		}
+	}
+	const int det = aa * bb - ab * ab;
+	if (det == 0) { return false; }
+	for (int ch = 0; ch < 3; ch++) {
+		c0[ch] = Clamp255(RoundDiv(bb * xa[ch] - ab * xb[ch], det));
+		c1[ch] = Clamp255(RoundDiv(aa * xb[ch] - ab * xa[ch], det));
+	}
+	return true;
+}
+
+struct ColorBlock {
+	uint16_t c0, c1;
+	uint32_t indices;
+	uint32_t error;
+};
+
+static uint32_t PackIndices(const unsigned char indices[16]) {
+	uint32_t bits = 0;
+	for (int i = 0; i < 16; i++) { bits |= (uint32_t)indices[i] << (2 * i); }
+	return bits;
+}
+
+// 4-color mode: c0 > c1.
+static ColorBlock FitColor4(const Block& block, unsigned int used, const int e0[3], const int e1[3], unsigned char indices[16]) {
+	uint16_t q0 = To565(e0), q1 = To565(e1);
+	if (q0 < q1) { std::swap(q0, q1); }
+
+	int p[4][3];
+	From565(q0, p[0]);
+	From565(q1, p[1]);
+	for (int ch = 0; ch < 3; ch++) {
+		p[2][ch] = (2 * p[0][ch] + p[1][ch]) / 3;
+		p[3][ch] = (p[0][ch] + 2 * p[1][ch]) / 3;
+	}
+	uint32_t palette[4] = { PackRGB(p[0]), PackRGB(p[1]), PackRGB(p[2]), PackRGB(p[3]) };
+	// Equal endpoints decode in 3-color mode, where index 3 is transparent; never pick it.
+	if (q0 == q1) { palette[3] = palette[0]; }
+
+	ColorBlock out;
+	out.c0 = q0;
+	out.c1 = q1;
+	out.error = SelectIndices(block, palette, used, indices);
+	out.indices = PackIndices(indices);
+	return out;
+}
+
+// 3-color mode: c0 <= c1, index 3 is transparent black.
+static ColorBlock FitColor3(const Block& block, unsigned int opaque, const int e0[3], const int e1[3]) {
+	uint16_t q0 = To565(e0), q1 = To565(e1);
+	if (q0 > q1) { std::swap(q0, q1); }
+
+	int p[3][3];
+	From565(q0, p[0]);
+	From565(q1, p[1]);
+	for (int ch = 0; ch < 3; ch++) { p[2][ch] = (p[0][ch] + p[1][ch]) / 2; }
+	const uint32_t palette[4] = { PackRGB(p[0]), PackRGB(p[1]), PackRGB(p[2]), PackRGB(p[0]) };
+
+	unsigned char indices[16];
+	ColorBlock out;
+	out.c0 = q0;
+	out.c1 = q1;
+	out.error = SelectIndices(block, palette, opaque, indices);
+	for (int i = 0; i < 16; i++) {
+		if (!(opaque >> i & 1)) { indices[i] = 3; }
+	}
+	out.indices = PackIndices(indices);
+	return out;
+}
+
+// 8-byte BC1 color block; 'used' pixels are the ones whose color matters.
+static void EncodeColor(const Block& block, unsigned int used, bool punch_through, unsigned char* out) {
+	ColorBlock best = { 0, 0, punch_through ? 0xFFFFFFFFu : 0u, 0 };	// Nothing visible
+	int e0[3], e1[3];
+	if (BoxEndpoints(block, used, e0, e1)) {
+		if (punch_through) {
+			best = FitColor3(block, used, e0, e1);
+		}
+		else {
+			unsigned char indices[16];
+			best = FitColor4(block, used, e0, e1, indices);
+			From565(best.c0, e0);
+			From565(best.c1, e1);
+			if (best.error > 0 && RefitEndpoints(block, used, indices, e0, e1)) {
+				const ColorBlock refit = FitColor4(block, used, e0, e1, indices);
+				if (refit.error < best.error) { best = refit; }
+			}
+		}
+	}
+
+	out[0] = (unsigned char)best.c0; out[1] = (unsigned char)(best.c0 >> 8);
+	out[2] = (unsigned char)best.c1; out[3] = (unsigned char)(best.c1 >> 8);
+	for (int b = 0; b < 4; b++) { out[4 + b] = (unsigned char)(best.indices >> (8 * b)); }
+}
+
+/*** BC3 alpha ***/
+
+static void EncodeAlphaBC3(const Block& block, unsigned char* out) {
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++) {
+		lo = std::min(lo, (int)block.px[i][3]);
+		hi = std::max(hi, (int)block.px[i][3]);
+	}
+
+	// a0 > a1 selects the 8-value mode; equal endpoints leave every index at 0.
+	uint64_t bits = 0;
+	if (hi != lo) {
+		int palette[8] = { hi, lo };
+		for (int k = 2; k < 8; k++) { palette[k] = ((8 - k) * hi + (k - 1) * lo) / 7; }
+		for (int i = 0; i < 16; i++) {
+			int best = 256, index = 0;
+			for (int k = 0; k < 8; k++) {
+				const int d = std::abs(palette[k] - (int)block.px[i][3]);
+				if (d < best) { best = d; index = k; }
+			}
+			bits |= (uint64_t)index << (3 * i);
+		}
+	}
+
+	out[0] = (unsigned char)hi;
+	out[1] = (unsigned char)lo;
+	for (int b = 0; b < 6; b++) { out[2 + b] = (unsigned char)(bits >> (8 * b)); }
+}
+
+/*** ETC2 ***/
+
+// ETC stores pixels column-major.
+static inline int EtcPixel(int x, int y) { return x * 4 + y; }
+
+static const int kEacModifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 }, { -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 }, { -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 }, { -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 }, { -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 }, { -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 }, { -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 }, { -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 }, { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+#define LS_EAC_FLAT_TABLE 13	// Has a 0 modifier (index 4)
+
+static void EncodeAlphaEAC(const Block& block, unsigned char* out) {
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++) {
+		lo = std::min(lo, (int)block.px[i][3]);
+		hi = std::max(hi, (int)block.px[i][3]);
+	}
+
+	int best_base = lo, best_mul = 1, best_table = LS_EAC_FLAT_TABLE;
+	unsigned char best_idx[16];
+	memset(best_idx, 4, sizeof(best_idx));
+	if (hi != lo) {
+		// Fit each table's range over [lo, hi], then try the neighbouring multipliers & bases.
+		uint32_t best_error = UINT32_MAX;
+		for (int t = 0; t < 16 && best_error > 0; t++) {
+			const int* mod = kEacModifiers[t];
+			const int guess_mul = std::max(1, std::min(15, RoundDiv(hi - lo, mod[7] - mod[3])));
+			for (int mul = std::max(1, guess_mul - 1); mul <= std::min(15, guess_mul + 1); mul++) {
+				const int guess_base = RoundDiv(hi + lo - mul * (mod[3] + mod[7]), 2);
+				for (int base = std::max(0, guess_base - 1); base <= std::min(255, guess_base + 1); base++) {
+					uint32_t error = 0;
+					unsigned char idx[16];
+					for (int i = 0; i < 16 && error < best_error; i++) {
+						uint32_t best = UINT32_MAX;
+						for (int k = 0; k < 8; k++) {
+							const int d = Clamp255(base + mod[k] * mul) - (int)block.px[i][3];
+							if ((uint32_t)(d * d) < best) { best = (uint32_t)(d * d); idx[i] = (unsigned char)k; }
+						}
+						error += best;
+					}
+					if (error < best_error) {
+						best_error = error;
+						best_base = base; best_mul = mul; best_table = t;
+						memcpy(best_idx, idx, sizeof(idx));
+					}
+				}
+			}
+		}
+	}
+
+	uint64_t bits = 0;
+	for (int y = 0; y < 4; y++) {
+		for (int x = 0; x < 4; x++) {
+			bits |= (uint64_t)best_idx[y * 4 + x] << (45 - 3 * EtcPixel(x, y));
+		}
+	}
+	out[0] = (unsigned char)best_base;
+	out[1] = (unsigned char)(best_mul << 4 | best_table);
+	for (int b = 0; b < 6; b++) { out[2 + b] = (unsigned char)(bits >> (40 - 8 * b)); }
+}
+
+static const int kEtcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+// Half of an ETC block: a 2x4 (flip = 0) or 4x2 (flip = 1) sub-block.
+struct EtcHalf {
+	int pixels[8];	// Row-major indices into the block
+};
+
+static EtcHalf MakeHalf(int flip, int half) {
+	EtcHalf h;
+	int n = 0;
+	for (int y = 0; y < 4; y++) {
+		for (int x = 0; x < 4; x++) {
+			if ((flip ? y : x) / 2 == half) { h.pixels[n++] = y * 4 + x; }
+		}
+	}
+	return h;
+}
+
+static void AverageHalf(const Block& block, const EtcHalf& h, unsigned int used, int avg[3]) {
+	int sum[3] = { 0, 0, 0 }, count = 0;
+	for (int p : h.pixels) {
+		if (!(used >> p & 1)) { continue; }
+		for (int ch = 0; ch < 3; ch++) { sum[ch] += block.px[p][ch]; }
+		count++;
+	}
+	for (int ch = 0; ch < 3; ch++) { avg[ch] = count ? RoundDiv(sum[ch], count) : 0; }
+}
+
+// Picks the best modifier table for a half around 'base'; fills its pixel index bits.
+static uint32_t FitHalf(const Block& block, const EtcHalf& h, unsigned int used, const int base[3], int& table, uint32_t& msb, uint32_t& lsb) {
+	uint32_t best_error = UINT32_MAX;
+	unsigned char best_mods[8] = { 0 };
+	for (int t = 0; t < 8 && best_error > 0; t++) {
+		uint32_t error = 0;
+		unsigned char mods[8];
+		for (int n = 0; n < 8; n++) {
+			const unsigned char* px = block.px[h.pixels[n]];
+			uint32_t best = UINT32_MAX;
+			for (int m = 0; m < 4; m++) {
+				// Index 0: +a, 1: +b, 2: -a, 3: -b
+				const int delta = (m & 2) ? -kEtcModifiers[t][m & 1] : kEtcModifiers[t][m & 1];
+				uint32_t dist = 0;
+				for (int ch = 0; ch < 3; ch++) {
+					const int d = Clamp255(base[ch] + delta) - (int)px[ch];
+					dist += (uint32_t)(d * d);
+				}
+				if (dist < best) { best = dist; mods[n] = (unsigned char)m; }
+			}
+			if (used >> h.pixels[n] & 1) { error += best; }
+		}
+		if (error < best_error) {
+			best_error = error;
+			table = t;
+			memcpy(best_mods, mods, sizeof(mods));
+		}
+	}
+
+	for (int n = 0; n < 8; n++) {
+		const int bit = EtcPixel(h.pixels[n] % 4, h.pixels[n] / 4);
+		msb |= (uint32_t)(best_mods[n] >> 1) << bit;
+		lsb |= (uint32_t)(best_mods[n] & 1) << bit;
+	}
+	return best_error;
+}
+
+// 8-byte ETC1 color block, which every ETC2 decoder reads as is. Differential blocks keep their
+// second color in range so they never alias the ETC2-only T, H & planar modes.
+static void EncodeEtcColor(const Block& block, unsigned int used, unsigned char* out) {
+	uint64_t best_bits = 0;
+	uint32_t best_error = UINT32_MAX;
+	for (int flip = 0; flip < 2; flip++) {
+		const EtcHalf halves[2] = { MakeHalf(flip, 0), MakeHalf(flip, 1) };
+		int avg[2][3];
+		AverageHalf(block, halves[0], used, avg[0]);
+		AverageHalf(block, halves[1], used, avg[1]);
+
+		for (int diff = 0; diff < 2; diff++) {
+			int base[2][3];
+			uint64_t bits = 0;
+			if (diff) {
+				for (int ch = 0; ch < 3; ch++) {
+					const int q0 = (avg[0][ch] * 31 + 127) / 255;
+					const int d = std::max(-4, std::min(3, (avg[1][ch] * 31 + 127) / 255 - q0));
+					base[0][ch] = Expand5(q0);
+					base[1][ch] = Expand5(q0 + d);
+					bits |= (uint64_t)q0 << (59 - 8 * ch) | (uint64_t)(d & 7) << (56 - 8 * ch);
+				}
+			}
+			else {
+				for (int ch = 0; ch < 3; ch++) {
+					const int q0 = (avg[0][ch] * 15 + 127) / 255;
+					const int q1 = (avg[1][ch] * 15 + 127) / 255;
+					base[0][ch] = q0 << 4 | q0;
+					base[1][ch] = q1 << 4 | q1;
+					bits |= (uint64_t)q0 << (60 - 8 * ch) | (uint64_t)q1 << (56 - 8 * ch);
+				}
+			}
+
+			int tables[2] = { 0, 0 };
+			uint32_t msb = 0, lsb = 0;
+			uint32_t error = FitHalf(block, halves[0], used, base[0], tables[0], msb, lsb);
+			error += FitHalf(block, halves[1], used, base[1], tables[1], msb, lsb);
+			bits |= (uint64_t)tables[0] << 37 | (uint64_t)tables[1] << 34 | (uint64_t)diff << 33 | (uint64_t)flip << 32;
+			bits |= (uint64_t)msb << 16 | lsb;
+			if (error < best_error) {
+				best_error = error;
+				best_bits = bits;
+			}
+		}
+	}
+	for (int b = 0; b < 8; b++) { out[b] = (unsigned char)(best_bits >> (56 - 8 * b)); }
+}
+
+/*** Dispatch ***/
+
+static void EncodeBlock(const Block& block, unsigned char* out, BlockFormat format) {
+	unsigned int visible = 0, opaque = 0;
+	for (int i = 0; i < 16; i++) {
+		if (block.px[i][3] > 0) { visible |= 1u << i; }
+		if (block.px[i][3] >= 128) { opaque |= 1u << i; }
+	}
+
+	switch (format) {
+	case BlockFormat::BC1:
+		EncodeColor(block, opaque, opaque != 0xFFFF, out);
+		break;
+	case BlockFormat::BC3:
+		EncodeAlphaBC3(block, out);
+		EncodeColor(block, visible, false, out + 8);
+		break;
+	case BlockFormat::ETC2:
+		EncodeAlphaEAC(block, out);
+		EncodeEtcColor(block, visible, out + 8);
+		break;
+	}
+}
+
+size_t BlockSize(BlockFormat format) {
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t EncodedSize(int width, int height, BlockFormat format) {
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+}
+
+bool EncodeBlocks(const unsigned char* rgba, int width, int height, unsigned char* out, BlockFormat format, int threads) {
+	if (width <= 0 || height <= 0 || width % 4 != 0 || height % 4 != 0) { return false; }
+
+	const int blocks_x = width / 4, rows = height / 4;
+	const size_t block_size = BlockSize(format);
+	std::atomic<int> next_row(0);
+	auto worker = [&]() {
+		Block block;
+		for (int row; (row = next_row++) < rows;) {
+			unsigned char* dst = out + (size_t)row * blocks_x * block_size;
+			for (int bx = 0; bx < blocks_x; bx++) {
+				for (int y = 0; y < 4; y++) {
+					memcpy(block.px[y * 4], rgba + ((size_t)(row * 4 + y) * width + bx * 4) * 4, 16);
+				}
+				EncodeBlock(block, dst + bx * block_size, format);
+			}
+		}
+	};
+
+	if (threads <= 0) { threads = (int)std::thread::hardware_concurrency(); }
+	threads = std::max(1, std::min(threads, rows));
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; t++) { pool.emplace_back(worker); }
+	worker();
+	for (auto& thread : pool) { thread.join(); }
+	return true;
+}
+
+}
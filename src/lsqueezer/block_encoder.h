@@ -0,0 +1,40 @@
+/* block_encoder.*: CPU block compression for finished atlas pages.
+	Every format works on 4x4 pixel blocks, so the page's width and height must be multiples of 4.
+	The output is deterministic: the same pixels always encode to the same bytes.
+	*/
+#pragma once
+#include <stddef.h>
+
+namespace ls {
+
+/* BlockFormat:
+	Block-compressed formats atlases can be encoded into.
+	*/
+enum class BlockFormat {
+	BC1,	// DXT1; 8 bytes per block, 1-bit alpha (alpha < 128 is transparent)
+	BC3,	// DXT5; 16 bytes per block, interpolated 8-bit alpha
+	ETC2,	// ETC2 RGBA (EAC alpha); 16 bytes per block. Color blocks only use ETC1 modes
+};
+
+/* BlockSize():
+	Size of an encoded 4x4 block in 'format'.
+	*/
+size_t BlockSize(BlockFormat format);
+
+/* EncodedSize():
+	Size of a 'width' x 'height' page encoded in 'format'.
+	*/
+size_t EncodedSize(int width, int height, BlockFormat format);
+
+/* EncodeBlocks():
+	Encodes a whole RGBA8 page, splitting block rows between worker threads.
+
+	* Rgba: pixel data; 'width' * 'height' * 4 bytes;
+	* Width, Height: page dimensions; multiples of 4;
+	* Out: output; EncodedSize(width, height, format) bytes;
+	* Threads: worker count; 0 uses every hardware thread;
+	* Returns: false if the dimensions are not block aligned.
+	*/
+bool EncodeBlocks(const unsigned char* rgba, int width, int height, unsigned char* out, BlockFormat format, int threads = 0);
+
+}
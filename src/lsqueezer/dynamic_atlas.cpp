@@ -0,0 +1,197 @@
+#include "dynamic_atlas.h"
+#include "pixel_ops.h"
+#include <algorithm>
+
+lsdynamic::lsdynamic(const int w, const int h, const bool verbose, const int flags) :
+	verbose_(verbose), flags_(flags), pack_(w, h, (flags & LS_FLAG_ALLOW_ROTATION) != 0), frame_(0) {
+	page_ = GenImageColor(w, h, BLANK);
+	if (verbose_) { printf("LSQUEEZER: Dynamic atlas created (%dx%d)\n", w, h); }
+}
+
+lsdynamic::~lsdynamic() {
+	UnloadImage(page_);
+}
+
+rbp::Rect lsdynamic::Place(const rbp::Rect& src) {
+	// Rects the page can't hold either way never fit, whatever gets evicted.
+	const bool fits = src.width <= page_.width && src.height <= page_.height;
+	const bool fits_rotated = (flags_ & LS_FLAG_ALLOW_ROTATION) != 0 && src.height <= page_.width && src.width <= page_.height;
+	if (!fits && !fits_rotated) { return {}; }
+
+	rbp::Rect r = pack_.Insert(src.width, src.height, rbp::MaxRectsBinPack::RectBestShortSideFit);
+	if (r.height != 0) { return r; }
+
+	// Evict the least recently used entries, never the ones used during this frame.
+	const size_t needed = (size_t)src.width * src.height;
+	size_t free_area = (size_t)page_.width * page_.height, evictable = 0;
+	std::vector<std::map<std::string, slot>::iterator> candidates;
+	for (auto it = slots_.begin(); it != slots_.end(); ++it) {
+		const size_t area = (size_t)it->second.rect.width * it->second.rect.height;
+		free_area -= area;
+		if (it->second.last_used < frame_) {
+			candidates.push_back(it);
+			evictable += area;
+		}
+	}
+	if (free_area + evictable < needed) { return r; }	// Not even evicting everything would do
+	std::sort(candidates.begin(), candidates.end(),
+		[](const auto& a, const auto& b) { return a->second.last_used < b->second.last_used; });
+
+	for (auto& it : candidates) {
+		if (verbose_) { printf("LSQUEEZER: Evicting (%s) from dynamic atlas\n", it->first.c_str()); }
+		free_area += (size_t)it->second.rect.width * it->second.rect.height;
+		pack_.Free(it->second.rect);
+		slots_.erase(it);
+		if (free_area < needed) { continue; }	// Can't fit yet
+		r = pack_.Insert(src.width, src.height, rbp::MaxRectsBinPack::RectBestShortSideFit);
+		if (r.height != 0) { break; }
+	}
+	return r;
+}
+
+AtlasComponent lsdynamic::Insert(const char* tag) {
+	auto it = slots_.find(tag);
+	if (it != slots_.end()) {
+		it->second.last_used = frame_;
+		return it->second.component;
+	}
+
+	auto entry = ace::LoadContent(tag);
+	if (entry == nullptr) {
+		printf("ERROR AT " __FUNCTION__ ": Could not find (%s) in ace!\n", tag);
+		return { 0 };
+	}
+	Image img = LoadImageFromMemory(entry->type.c_str(), entry->data, entry->size);
+	entry->Dispose();
+	if (img.data == NULL) {
+		printf("ERROR AT " __FUNCTION__ ": Could not load image (%s)!\n", tag);
+		return { 0 };
+	}
+	AtlasComponent component = Insert(tag, img);
+	UnloadImage(img);
+	return component;
+}
+
+AtlasComponent lsdynamic::Insert(const char* tag, const Image& img) {
+	auto it = slots_.find(tag);
+	if (it != slots_.end()) {
+		it->second.last_used = frame_;
+		return it->second.component;
+	}
+	if (img.data == NULL || img.width <= 0 || img.height <= 0) {
+		printf("ERROR AT " __FUNCTION__ ": (%s) holds no image!\n", tag);
+		return { 0 };
+	}
+
+	Image rgba = img;
+	if (img.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+		rgba = ImageCopy(img);
+		ImageFormat(&rgba, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+		if (rgba.data == NULL || rgba.format != PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) {
+			printf("ERROR AT " __FUNCTION__ ": Could not convert (%s) to RGBA8!\n", tag);
+			UnloadImage(rgba);
+			return { 0 };
+		}
+	}
+
+	const rbp::Rect src = ls::PackedRegion((const unsigned char*)rgba.data, rgba.width, rgba.height,
+		(flags_ & LS_FLAG_TRIM) != 0);
+	const rbp::Rect r = Place(src);
+	if (r.height == 0) {
+		printf("ERROR AT " __FUNCTION__ ": (%s) does not fit inside the dynamic atlas!\n", tag);
+		if (rgba.data != img.data) { UnloadImage(rgba); }
+		return { 0 };
+	}
+
+	const bool rotated = r.width != src.width;
+	ls::BlitPixels((unsigned char*)page_.data, page_.width, (const unsigned char*)rgba.data, rgba.width, src, r.x, r.y, rotated);
+	if (rgba.data != img.data) { UnloadImage(rgba); }
+	dirty_.push_back(r);
+
+	slot s = { { src.width, src.height, r.x, r.y, (float)src.x, (float)src.y, img.width, img.height, rotated }, r, frame_ };
+	slots_[tag] = s;
+	if (verbose_) { printf("LSQUEEZER: Inserted (%s) into dynamic atlas%s\n", tag, rotated ? " (rotated)" : ""); }
+	return s.component;
+}
+
+AtlasComponent lsdynamic::operator[](const char* tag) {
+	auto it = slots_.find(tag);
+	if (it == slots_.end()) { return { 0 }; }
+	it->second.last_used = frame_;
+	return it->second.component;
+}
+
+bool lsdynamic::Evict(const char* tag) {
+	auto it = slots_.find(tag);
+	if (it == slots_.end()) { return false; }
+	pack_.Free(it->second.rect);
+	slots_.erase(it);
+	return true;
+}
+
+void lsdynamic::NextFrame() {
+	frame_++;
+}
+
+void lsdynamic::Update(Texture2D texture) {
+	if (dirty_.empty()) { return; }
+
+	// Past half of the page, one upload beats many small ones.
+	size_t dirty_area = 0;
+	for (auto& r : dirty_) { dirty_area += (size_t)r.width * r.height; }
+	if (dirty_area * 2 >= (size_t)page_.width * page_.height) {
+		UpdateTextureRec(texture, { 0, 0, (float)page_.width, (float)page_.height }, page_.data);
+		dirty_.clear();
+		return;
+	}
+
+	std::vector<unsigned char> staging;
+	for (auto& r : dirty_) {
+		const size_t row_bytes = (size_t)r.width * 4;
+		staging.resize(row_bytes * r.height);
+		for (int y = 0; y < r.height; y++) {
+			const unsigned char* row = (const unsigned char*)page_.data + ((size_t)(r.y + y) * page_.width + r.x) * 4;
+			memcpy(staging.data() + y * row_bytes, row, row_bytes);
+		}
+		UpdateTextureRec(texture, { (float)r.x, (float)r.y, (float)r.width, (float)r.height }, staging.data());
+	}
+	dirty_.clear();
+}
+
+extern "C" {
+	LS_Dynamic* LS_CreateDynamic(const int w, const int h, const bool verbose, const int flags) {
+		return new lsdynamic(w, h, verbose, flags);
+	}
+
+	AtlasComponent LS_DynamicInsert(LS_Dynamic* atlas, const char* tag) {
+		return atlas->Insert(tag);
+	}
+
+	AtlasComponent LS_DynamicInsertImage(LS_Dynamic* atlas, const char* tag, Image img) {
+		return atlas->Insert(tag, img);
+	}
+
+	AtlasComponent LS_DynamicGet(LS_Dynamic* atlas, const char* tag) {
+		return (*atlas)[tag];
+	}
+
+	bool LS_DynamicEvict(LS_Dynamic* atlas, const char* tag) {
+		return atlas->Evict(tag);
+	}
+
+	void LS_DynamicNextFrame(LS_Dynamic* atlas) {
+		atlas->NextFrame();
+	}
+
+	Image LS_DynamicImage(LS_Dynamic* atlas) {
+		return atlas->GetImage();
+	}
+
+	void LS_DynamicUpdate(LS_Dynamic* atlas, Texture2D texture) {
+		atlas->Update(texture);
+	}
+
+	void LS_DestroyDynamic(LS_Dynamic* atlas) {
+		delete atlas;
+	}
+}
@@ -0,0 +1,95 @@
+/* dynamic_atlas.*: an atlas that lives for as long as the application wants it to.
+	Entries are packed one by one into the remaining free space, the least recently used
+	ones are evicted when it runs out, and only the regions that changed are uploaded.
+	*/
+#pragma once
+#include "lesser_squeezer.h"
+
+#ifdef __cplusplus
+#include "MaxRectsBinPack.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class lsdynamic {
+	struct slot {
+		AtlasComponent component;
+		rbp::Rect rect;					// As returned by the packer
+		unsigned long long last_used;	// Frame in which it was last inserted/retrieved
+	};
+
+	const bool verbose_;
+	const int flags_;
+	rbp::MaxRectsBinPack pack_;
+	Image page_;
+	std::map<std::string, slot> slots_;
+	std::vector<rbp::Rect> dirty_;
+	unsigned long long frame_;
+
+	rbp::Rect inline Place(const rbp::Rect& src);
+
+public:
+	lsdynamic(const int w, const int h, const bool verbose = false, const int flags = LS_FLAG_NONE);
+	~lsdynamic();
+	lsdynamic(lsdynamic const&) = delete;
+	lsdynamic& operator=(lsdynamic const&) = delete;
+
+	/* Insert():
+		Pack an ace entry into the atlas, evicting entries that weren't used during the
+		current frame if there's no space left.
+
+		* Tag: id of the entry; inserting a tag twice just marks it as used;
+		* Returns: the entry's component, or a NULL struct if it didn't fit.
+		*/
+	AtlasComponent Insert(const char* tag);
+
+	/* Insert():
+		Same as above, for images that don't come from ace (e.g. rasterized glyphs).
+		*/
+	AtlasComponent Insert(const char* tag, const Image& img);
+
+	/* operator[]:
+		Get a component and mark it as used during the current frame; returns a NULL
+		struct if the tag is not inside the atlas.
+		*/
+	AtlasComponent operator[](const char* tag);
+
+	/* Evict():
+		Remove an entry from the atlas; its region is reused by later inserts.
+		*/
+	bool Evict(const char* tag);
+
+	/* NextFrame():
+		Advance the LRU clock; call once per frame.
+		*/
+	void NextFrame();
+
+	/* GetImage():
+		CPU copy of the atlas; use it to create the texture once.
+		*/
+	const Image& GetImage() const { return page_; }
+
+	/* Update():
+		Upload every region that changed since the last call with UpdateTextureRec().
+		*/
+	void Update(Texture2D texture);
+};
+
+typedef lsdynamic LS_Dynamic;
+#else
+typedef struct lsdynamic LS_Dynamic;
+
+	/* Dynamic atlases:
+		C bindings of the 'lsdynamic' class; every LS_CreateDynamic() must be paired with
+		a call to LS_DestroyDynamic().
+		*/
+	LS_Dynamic* LS_CreateDynamic(const int w, const int h, const bool verbose, const int flags);
+	AtlasComponent LS_DynamicInsert(LS_Dynamic* atlas, const char* tag);
+	AtlasComponent LS_DynamicInsertImage(LS_Dynamic* atlas, const char* tag, Image img);
+	AtlasComponent LS_DynamicGet(LS_Dynamic* atlas, const char* tag);
+	bool LS_DynamicEvict(LS_Dynamic* atlas, const char* tag);
+	void LS_DynamicNextFrame(LS_Dynamic* atlas);
+	Image LS_DynamicImage(LS_Dynamic* atlas);
+	void LS_DynamicUpdate(LS_Dynamic* atlas, Texture2D texture);
+	void LS_DestroyDynamic(LS_Dynamic* atlas);
+#endif
@@ -17,78 +17,235 @@
  */
 
 #include "lesser_squeezer.h"
-#include "Rect.h"
-#include "MaxRectsBinPack.h"
+#include "atlas_builder.h"
+#include "pixel_ops.h"
 #include <fstream>
+#include <unordered_map>
 #include <filesystem>
+#include <atomic>
+#include <thread>
 #include <assert.h>
 
 static lsqueezer* s_lsqueezer = nullptr;
 
+static int RaylibFormat(const int format) {
+	switch (format) {
+	case LS_FORMAT_RGBA4444: return PIXELFORMAT_UNCOMPRESSED_R4G4B4A4;
+	case LS_FORMAT_RGB565: return PIXELFORMAT_UNCOMPRESSED_R5G6B5;
+	case LS_FORMAT_ALPHA8: return PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+	case LS_FORMAT_BC1: return PIXELFORMAT_COMPRESSED_DXT1_RGBA;
+	case LS_FORMAT_BC3: return PIXELFORMAT_COMPRESSED_DXT5_RGBA;
+	case LS_FORMAT_ETC2: return PIXELFORMAT_COMPRESSED_ETC2_EAC_RGBA;
+	default: return PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+	}
+}
+
+// Decodes an entry; the result is always RGBA8, whatever the file holds.
+static Image LoadEntryImage(const ace_entry& elem) {
+	Image img = LoadImageFromMemory(elem->type.c_str(), elem->data, elem->size);
+	if (img.data == NULL || img.format == PIXELFORMAT_UNCOMPRESSED_R8G8B8A8) { return img; }
+
+	int channels = 0;
+	switch (img.format) {
+	case PIXELFORMAT_UNCOMPRESSED_GRAYSCALE: channels = 1; break;
+	case PIXELFORMAT_UNCOMPRESSED_GRAY_ALPHA: channels = 2; break;
+	case PIXELFORMAT_UNCOMPRESSED_R8G8B8: channels = 3; break;
+	default:
+		ImageFormat(&img, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);	// HDR & friends; rare enough
+		return img;
+	}
+	unsigned char* rgba = (unsigned char*)malloc((size_t)img.width * img.height * 4);
+	ls::ExpandToRGBA8((const unsigned char*)img.data, channels, rgba, (size_t)img.width * img.height);
+	UnloadImage(img);
+	img.data = rgba;
+	img.format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8;
+	return img;
+}
+
+void lsqueezer::SetComponent(const std::string& tag, const AtlasComponent& component) {
+	auto it = handles_.emplace(tag, (LS_Handle)components_.size());
+	if (it.second) { components_.push_back(component); }
+	else { components_[it.first->second] = component; }
+}
+
 Image lsqueezer::CreateBinFromEntries(ace_buffer& entries) {
-	if (verbose_) { puts("LSQUEEZER: Generating & populating buffers"); }
-	Image bin_image = GenImageColor(bin_width_, bin_height_, BLANK);
-
-	std::vector<rbp::RectSize> dimensions;
-	for (size_t i = 0; i < entries.size(); i++) {
-		// TODO: ideally store size in ace...
-		auto& elem = entries[i];
-		Image img;
-		img = LoadImageFromMemory(elem->type.c_str(), elem->data, elem->size);
-		rbp::RectSize rs = { img.width, img.height };
-		dimensions.push_back(rs);
-		UnloadImage(img);
-	}
-
-	float best_occupancy = 0.0f;
-	std::vector<rbp::Rect> rects;
-	for (char i = 0; i < 5; i++) {
-		// TODO: Move to Guilloutine Packer.
-		rbp::MaxRectsBinPack pack(bin_width_, bin_height_, false);
-		std::vector<rbp::Rect> out;
-
-		double occupancy = 0;
-		if (verbose_) { printf("LSQUEEZER: Calculating occupancy using method #%d\n", i); }
-		for (size_t i = 0; i < dimensions.size(); i++) {
-			rbp::RectSize& rs = dimensions[i];
-			out.push_back(pack.Insert(rs.width, rs.height, (rbp::MaxRectsBinPack::FreeRectChoiceHeuristic)i));
-		}
+	std::vector<std::string> ids;
+	for (auto& e : entries) { ids.push_back(e->id); }
+	return CreateBin(ids, [&](size_t i) { return entries[i]; }, false);
+}
 
-		if (out.size() != dimensions.size()) {
-			puts("ERROR AT " __FUNCTION__ ": Atlas size too small. Aborting.");
-			return { 0 };
-		}
+Image lsqueezer::CreateBin(const std::vector<std::string>& ids, const std::function<ace_entry(size_t)>& fetch, const bool release) {
+	// Entries are only reached through 'fetch'; when streaming, each one is released as soon as it
+	// has been read, so only a couple of them (& their decoded images) live alongside the bin.
+	ls::Source source;
+	source.count = ids.size();
+	source.name = [&](size_t i) { return ids[i].c_str(); };
+	source.decode = [&](size_t i, ls::Bitmap& out) {
+		ace_entry e = fetch(i);
+		if (e == nullptr) { return false; }
+		Image img = LoadEntryImage(e);
+		if (release) { e->Dispose(); }
+		out.pixels = (unsigned char*)img.data;
+		out.width = img.width;
+		out.height = img.height;
+		return img.data != NULL;
+	};
+	if (release) {
+		// Only the header is read; the entry is decompressed just as far as it goes.
+		source.size = [&](size_t i, int& width, int& height) {
+			unsigned char header[32];
+			const unsigned int read = ace::ReadRange(ids[i].c_str(), 0, sizeof(header), header);
+			return read != 0 && ls::ReadImageSize(header, read, width, height);
+		};
+	}
 
-		occupancy = pack.Occupancy();
-		if (verbose_) { printf("LSQUEEZER: Occupancy of method #%d: %.02f\n", i, occupancy); }
-		if (occupancy > best_occupancy) {
-			best_occupancy = occupancy;
-			rects.swap(out);
-		}
+	ls::Page page;
+	std::vector<AtlasComponent> components;
+	std::vector<bool> loaded;
+	if (!ls::BuildAtlas(source, { (int)bin_width_, (int)bin_height_, flags_, verbose_, encode_threads_ }, page, components, loaded)) { return {0}; }
+	for (size_t i = 0; i < ids.size(); i++) {
+		if (loaded[i]) { SetComponent(ids[i], components[i]); }
+	}
+	// raylib frees image data with free(), which is what the page was allocated with.
+	return { page.pixels, page.width, page.height, 1, RaylibFormat(page.format) };
+}
+
+/* Baked atlas layout:
+	[pixels][components][footer]
+
+	Pixels come first so the decompressed entry can be handed to the Image as is.
+	Components: per entry, a u32 id length, the id and 9 x 32-bit AtlasComponent fields.
+	Footer: components offset, component count, width, height, pixel format & magic.
+	*/
+#define LS_BAKED_MAGIC 0x3141534C	// "LSA1"
+#define LS_BAKED_FOOTER_SIZE (6 * sizeof(uint32_t))
+
+static void PutU32(std::vector<unsigned char>& out, uint32_t value) {
+	const size_t at = out.size();
+	out.resize(at + sizeof(uint32_t));
+	memcpy(out.data() + at, &value, sizeof(uint32_t));
+}
+
+static uint32_t GetU32(const unsigned char* in) {
+	uint32_t value;
+	memcpy(&value, in, sizeof(uint32_t));
+	return value;
+}
+
+std::vector<unsigned char> lsqueezer::Bake(ace_buffer& entries) {
+	std::vector<unsigned char> out;
+	Image img = CreateBinFromEntries(entries);
+	if (img.data == NULL) { return out; }
+
+	const size_t pixel_bytes = GetPixelDataSize(img.width, img.height, img.format);
+	out.resize(pixel_bytes);
+	memcpy(out.data(), img.data, pixel_bytes);
+	UnloadImage(img);
+
+	const uint32_t table_offset = (uint32_t)out.size();
+	// Written in handle order, so RunBaked() hands out the same handles.
+	std::vector<const std::string*> tags(components_.size());
+	for (auto& it : handles_) { tags[it.second] = &it.first; }
+	for (size_t h = 0; h < components_.size(); h++) {
+		const AtlasComponent& c = components_[h];
+		PutU32(out, (uint32_t)tags[h]->size());
+		out.insert(out.end(), tags[h]->begin(), tags[h]->end());
+		PutU32(out, c.width);
+		PutU32(out, c.height);
+		PutU32(out, c.x);
+		PutU32(out, c.y);
+		out.resize(out.size() + 2 * sizeof(float));
+		memcpy(out.data() + out.size() - 2 * sizeof(float), &c.x_offset, sizeof(float));
+		memcpy(out.data() + out.size() - sizeof(float), &c.y_offset, sizeof(float));
+		PutU32(out, c.source_width);
+		PutU32(out, c.source_height);
+		PutU32(out, c.rotated ? 1 : 0);
+	}
+	PutU32(out, table_offset);
+	PutU32(out, (uint32_t)components_.size());
+	PutU32(out, img.width);
+	PutU32(out, img.height);
+	PutU32(out, img.format);
+	PutU32(out, LS_BAKED_MAGIC);
+	return out;
+}
+
+// Bakes the atlases registered with ace's RegisterAtlas(); ace is handed it by EnableBaking(),
+// so it never depends on lsqueezer itself.
+static std::vector<unsigned char> BakeRegistered(ace_buffer& entries, int width, int height, int flags) {
+	lsqueezer squeezer(width, height, false, flags);
+	return squeezer.Bake(entries);
+}
+
+void lsqueezer::EnableBaking() {
+	ace::SetAtlasBaker(BakeRegistered, LS_BAKED_TYPE);
+}
+
+Image lsqueezer::RunBaked(const char* name) {
+	if (verbose_) { printf("LSQUEEZER: Loading baked atlas (%s)\n", name); }
+	auto entry = ace::LoadContent(name);
+	if (entry == nullptr || entry->type != LS_BAKED_TYPE || entry->size < LS_BAKED_FOOTER_SIZE) {
+		printf("ERROR AT " __FUNCTION__ ": (%s) is not a baked atlas!\n", name);
+		return {0};
 	}
 
-	if (best_occupancy <= 0) {
-		puts("ERROR AT " __FUNCTION__ ": 'best_occupancy' was less than/is 0. Aborting.");
+	const unsigned char* footer = entry->data + entry->size - LS_BAKED_FOOTER_SIZE;
+	const uint32_t table_offset = GetU32(footer);
+	const uint32_t count = GetU32(footer + 4);
+	Image img = { NULL, (int)GetU32(footer + 8), (int)GetU32(footer + 12), 1, (int)GetU32(footer + 16) };
+	const size_t table_end = entry->size - LS_BAKED_FOOTER_SIZE;
+	if (GetU32(footer + 20) != LS_BAKED_MAGIC || img.width <= 0 || img.height <= 0 || table_offset > table_end ||
+		(uint64_t)img.width * img.height > (uint64_t)table_offset * 2 ||	// Formats take at least 4 bits a pixel
+		(size_t)GetPixelDataSize(img.width, img.height, img.format) > table_offset) {
+		printf("ERROR AT " __FUNCTION__ ": Baked atlas (%s) is corrupted!\n", name);
+		entry->Dispose();
 		return {0};
 	}
 
-	if (verbose_) { puts("LSQUEEZER: Populating bin"); }
-	for (size_t i = 0; i < entries.size(); i++) {
-		auto& elem = entries[i];
-		Image img = LoadImageFromMemory(elem->type.c_str(), elem->data, elem->size);
-		rbp::Rect& r = rects[i];
-		assert(r.width == img.width);
-		assert(r.height == img.height);
-		if (verbose_) { printf("LSQUEEZER: Copying image (%s) to bin\n", elem->id.c_str()); }
-		for (size_t y_src = 0; y_src < img.height; y_src++) {
-			void* dest = (char*)bin_image.data + ((r.y + y_src) * bin_image.width + r.x) * 4;
-			void* src = (char*)img.data + y_src * img.width * 4;
-			memcpy(dest, src, img.width * 4);
+	// Each component takes 40 bytes plus its id; the table is read whole before any of it is used.
+	std::vector<std::pair<std::string, AtlasComponent>> components;
+	const unsigned char* it = entry->data + table_offset;
+	const unsigned char* end = entry->data + table_end;
+	bool valid = count <= (table_end - table_offset) / 40;
+	for (uint32_t i = 0; valid && i < count; i++) {
+		const size_t left = (size_t)(end - it);
+		const uint32_t id_size = left >= 40 ? GetU32(it) : 0;
+		if (left < 40 || id_size > left - 40) {
+			valid = false;
+			break;
 		}
-		map_[elem->id] = { r.width, r.height, r.x, r.y, 0, 0 };
-		UnloadImage(img);
+		std::string id((const char*)it + 4, id_size);
+		it += 4 + id_size;
+		AtlasComponent c;
+		c.width = (int)GetU32(it);
+		c.height = (int)GetU32(it + 4);
+		c.x = (int)GetU32(it + 8);
+		c.y = (int)GetU32(it + 12);
+		memcpy(&c.x_offset, it + 16, sizeof(float));
+		memcpy(&c.y_offset, it + 20, sizeof(float));
+		c.source_width = (int)GetU32(it + 24);
+		c.source_height = (int)GetU32(it + 28);
+		c.rotated = GetU32(it + 32) != 0;
+		it += 36;
+		components.emplace_back(std::move(id), c);
+	}
+	if (!valid) {
+		printf("ERROR AT " __FUNCTION__ ": Baked atlas (%s) is corrupted!\n", name);
+		entry->Dispose();
+		return {0};
 	}
-	return bin_image;
+	for (auto& component : components) { SetComponent(component.first, component.second); }
+
+	// The image takes ownership of the decompressed entry; the trailing table is just never read again.
+	// raylib frees images with free(), so data from a custom ace allocator has to be copied out.
+	if (!ace::UsesDefaultAllocator()) {
+		img.data = malloc(table_offset);
+		memcpy(img.data, entry->data, table_offset);
+		entry->Dispose();
+		return img;
+	}
+	img.data = entry->Release();
+	return img;
 }
 
 Image lsqueezer::Run(ace_buffer& entries) {
@@ -98,6 +255,12 @@ Image lsqueezer::Run(ace_buffer& entries) {
 
 Image lsqueezer::RunTags(const char** tags, int size) {
 	if (verbose_) { puts("LSQUEEZER: Preparing to run l[esser]squeezer!"); }
+	if (flags_ & LS_FLAG_STREAM) {
+		// Entries are pulled from ace one at a time, whenever CreateBin() needs them.
+		std::vector<std::string> ids(tags, tags + size);
+		return CreateBin(ids, [&](size_t i) { return ace::LoadContent(ids[i].c_str()); }, true);
+	}
+
 	if (verbose_) { puts("LSQUEEZER: Fetching requested content from ace"); }
 	auto entries = ace::LoadContentBuffer(tags, size);
 	return CreateBinFromEntries(entries);
@@ -107,106 +270,112 @@ Image lsqueezer::RunDirectory(const char** tags, int size, const char* folder_pa
 	namespace fs = std::filesystem;
 	if (verbose_) { puts("LSQUEEZER: Preparing to run l[esser]squeezer!"); }
 
-	if (verbose_) { printf("LSQUEEZER: Fetching files from directory (\"%s\")", folder_path); }
-	ace_buffer entries;
+	// Every requested tag gets exactly one source: the folder if it has the file, ace otherwise.
+	std::unordered_map<std::string, size_t> wanted;
+	std::vector<const char*> slot_tags;
+	wanted.reserve(size);
+	for (int i = 0; i < size; i++) {
+		if (wanted.emplace(tags[i], slot_tags.size()).second) { slot_tags.push_back(tags[i]); }
+	}
+	std::vector<ace_entry> found(slot_tags.size());
+
+	if (verbose_) { printf("LSQUEEZER: Fetching files from directory (\"%s\")\n", folder_path); }
+	std::error_code error;
 	std::string ext;
-	for (auto& entry : fs::directory_iterator(folder_path)) {
-		for (int i = 0; i < size; i++) {
-			if (entry.is_regular_file() && entry.path().has_extension() &&
-				ace::CheckFileFormat(ACE_SUPPORTED_IMG_FILEFORMATS, entry.path(), &ext)) {
-				if (entry.path().filename().string() == tags[i]) {
-					std::fstream in;
-					in.open(entry.path(), std::ios::in | std::ios::binary);
-					if (!in) {
-						printf("ERROR AT " __FUNCTION__ ": Could not open file! (\"%s\")\n", entry.path().c_str());
-						return {0};
-					}
-					ace_entry e = std::make_shared<EX_ace_entry_cpp>();
-					e->id = entry.path().filename().string();
-					e->type = ext;
-
-					std::filebuf* buf = in.rdbuf();
-					e->size = buf->pubseekoff(0, in.end, in.in);
-					buf->pubseekpos(0, in.in);
-					e->data = new unsigned char[e->size];
-					in.read((char*)e->data, e->size);
-					in.close();
-					entries.push_back(std::move(e));
-				}
-				else {
-					auto e = ace::LoadContent(tags[i]);
-					if (e != nullptr) { entries.push_back(e); }
-				}
-			}
+	for (auto& entry : fs::directory_iterator(folder_path, error)) {
+		if (!entry.is_regular_file() || !ace::CheckFileFormat(ACE_SUPPORTED_IMG_FILEFORMATS, entry.path(), ext)) { continue; }
+		auto it = wanted.find(entry.path().stem().string());	// Ids are file names without extension, as in ace
+		if (it == wanted.end() || found[it->second] != nullptr) { continue; }
+
+		std::ifstream in(entry.path(), std::ios::in | std::ios::binary);
+		if (!in) {
+			printf("ERROR AT " __FUNCTION__ ": Could not open file! (\"%s\")\n", entry.path().string().c_str());
+			return {0};
 		}
+		ace_entry e = std::make_shared<EX_ace_entry_cpp>();
+		e->id = it->first;
+		e->type = ext;
+
+		std::filebuf* buf = in.rdbuf();
+		e->size = buf->pubseekoff(0, in.end, in.in);
+		buf->pubseekpos(0, in.in);
+		e->data = (unsigned char*)ace::Alloc(e->size);	// Freed through ace, like loaded entries
+		in.read((char*)e->data, e->size);
+		found[it->second] = std::move(e);
 	}
+	if (error) { printf("ERROR AT " __FUNCTION__ ": Could not read directory! (\"%s\")\n", folder_path); }
 
-	if (verbose_) { puts("LSQUEEZER: Generating & populating buffers"); }
-	Image bin_image = GenImageColor(bin_width_, bin_height_, BLANK);
-
-	std::vector<rbp::RectSize> dimensions;
-	for (size_t i = 0; i < entries.size(); i++) {
-		// TODO: ideally store size in ace...
-		auto& elem = entries[i];
-		Image img;
-		img = LoadImageFromMemory(elem->type.c_str(), elem->data, elem->size);
-		rbp::RectSize rs = { img.width, img.height };
-		dimensions.push_back(rs);
-		UnloadImage(img);
-	}
-
-	float best_occupancy = 0.0f;
-	std::vector<rbp::Rect> rects;
-	for (char i = 0; i < 5; i++) {
-		// TODO: Move to Guilloutine Packer.
-		rbp::MaxRectsBinPack pack(bin_width_, bin_height_, false);
-		std::vector<rbp::RectSize> temp_dimensions(dimensions);
-		std::vector<rbp::Rect> out;
-
-		double occupancy = 0;
-		if (verbose_) { printf("LSQUEEZER: Calculating occupancy using method #%d\n", i); }
-		pack.Insert(temp_dimensions, out, (rbp::MaxRectsBinPack::FreeRectChoiceHeuristic)i);
-
-		occupancy = pack.Occupancy();
-		if (verbose_) { printf("LSQUEEZER: Occupancy of method #%d: %.02f\n", i, occupancy); }
-		if (occupancy > best_occupancy) {
-			best_occupancy = occupancy;
-			rects.swap(out);
+	// Whatever the folder didn't have is pulled from ace in one go.
+	std::vector<const char*> missing;
+	for (size_t i = 0; i < found.size(); i++) {
+		if (found[i] == nullptr) { missing.push_back(slot_tags[i]); }
+	}
+	if (!missing.empty()) {
+		if (verbose_) { printf("LSQUEEZER: Fetching %d entries missing from the directory from ace\n", (int)missing.size()); }
+		ace_buffer loaded = ace::LoadContentBuffer(missing.data(), (int)missing.size());
+		for (auto& e : loaded) {
+			auto it = wanted.find(e->id);
+			if (it != wanted.end() && found[it->second] == nullptr) { found[it->second] = e; }
 		}
 	}
 
-	if (best_occupancy <= 0) {
-		puts("ERROR AT " __FUNCTION__ ": 'best_occupancy' was less than/is 0. Aborting.");
-		return {0};
+	ace_buffer entries;
+	for (auto& e : found) {
+		if (e != nullptr) { entries.push_back(std::move(e)); }
 	}
+	return CreateBinFromEntries(entries);
+}
+
+void lsqueezer::RunBatch(LS_BatchJob* jobs, int count, int threads) {
+	if (threads <= 0) { threads = (int)std::thread::hardware_concurrency(); }
+	threads = std::max(1, std::min(threads, count));
+	// Workers split the hardware threads for block encoding, rather than each using all of them.
+	const int encode_threads = std::max(1, (int)std::thread::hardware_concurrency() / threads);
 
-	if (verbose_) { puts("LSQUEEZER: Populating bin"); }
-	for (size_t i = 0; i < entries.size(); i++) {
-		auto& elem = entries[i];
-		Image img = LoadImageFromMemory(elem->type.c_str(), elem->data, elem->size);
-		rbp::Rect& r = rects[i];
-		assert(r.width == img.width);
-		assert(r.height == img.height);
-		if (verbose_) { printf("LSQUEEZER: Copying image (%s) to bin\n", elem->id.c_str()); }
-		for (size_t y_src = 0; y_src < img.height; y_src++) {
-			void* dest = (char*)bin_image.data + ((r.y + y_src) * bin_image.width + r.x) * 4;
-			void* src = (char*)img.data + y_src * img.width * 4;
-			memcpy(dest, src, img.width * 4);
+	// Jobs are handed out one by one, so a few large atlases don't hold up the rest.
+	std::atomic<int> next_job(0);
+	auto worker = [&]() {
+		for (int i; (i = next_job++) < count;) {
+			lsqueezer* squeezer = jobs[i].squeezer;
+			const int own_threads = squeezer->encode_threads_;
+			squeezer->encode_threads_ = encode_threads;
+			jobs[i].result = squeezer->RunTags(jobs[i].tags, jobs[i].size);
+			squeezer->encode_threads_ = own_threads;
 		}
-		map_[elem->id] = { r.width, r.height, r.x, r.y, 0, 0 };
-		UnloadImage(img);
-	}
-	return bin_image;
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 1; t < threads; t++) { pool.emplace_back(worker); }
+	worker();
+	for (auto& thread : pool) { thread.join(); }
 }
 
 extern "C" {
 	void LS_Init(const int w, const int h, const bool verbose) {
 		s_lsqueezer = new lsqueezer(w, h, verbose);
 	}
+
+	void LS_InitEx(const int w, const int h, const bool verbose, const int flags) {
+		s_lsqueezer = new lsqueezer(w, h, verbose, flags);
+	}
+
+	void LS_EnableBaking() {
+		lsqueezer::EnableBaking();
+	}
 	
 	AtlasComponent LS_GetComponent(const char* name) {
-		if (!s_lsqueezer) { puts("ERROR AT " __FUNCTION__ ": lsqueezer hasn't been initialized!"); }
-		else return (*s_lsqueezer)[name];
+		if (!s_lsqueezer) { puts("ERROR AT " __FUNCTION__ ": lsqueezer hasn't been initialized!"); return {0}; }
+		return (*s_lsqueezer)[name];
+	}
+
+	LS_Handle LS_GetHandle(const char* name) {
+		if (!s_lsqueezer) { puts("ERROR AT " __FUNCTION__ ": lsqueezer hasn't been initialized!"); return LS_INVALID_HANDLE; }
+		return s_lsqueezer->GetHandle(name);
+	}
+
+	AtlasComponent LS_GetComponentByHandle(const LS_Handle handle) {
+		if (!s_lsqueezer) { puts("ERROR AT " __FUNCTION__ ": lsqueezer hasn't been initialized!"); return {0}; }
+		return (*s_lsqueezer)[handle];
 	}
 	
 	Image LS_RunTags(const char** tags, int size) {
@@ -216,7 +385,48 @@ extern "C" {
 		return s_lsqueezer->RunDirectory(tags, size, folder_path);
 	}
 	
+	Image LS_RunBaked(const char* name) {
+		return s_lsqueezer->RunBaked(name);
+	}
+	
 	void LS_Stop() {
 		if (s_lsqueezer) delete s_lsqueezer;
+		s_lsqueezer = nullptr;
+	}
+
+	LS_Squeezer* LS_Create(const int w, const int h, const bool verbose, const int flags) {
+		return new lsqueezer(w, h, verbose, flags);
+	}
+
+	Image LS_SqueezerRunTags(LS_Squeezer* squeezer, const char** tags, int size) {
+		return squeezer->RunTags(tags, size);
+	}
+
+	Image LS_SqueezerRunDirectory(LS_Squeezer* squeezer, const char** tags, int size, const char* folder_path) {
+		return squeezer->RunDirectory(tags, size, folder_path);
+	}
+
+	Image LS_SqueezerRunBaked(LS_Squeezer* squeezer, const char* name) {
+		return squeezer->RunBaked(name);
+	}
+
+	AtlasComponent LS_SqueezerGetComponent(LS_Squeezer* squeezer, const char* name) {
+		return (*squeezer)[name];
+	}
+
+	LS_Handle LS_SqueezerGetHandle(LS_Squeezer* squeezer, const char* name) {
+		return squeezer->GetHandle(name);
+	}
+
+	AtlasComponent LS_SqueezerGetComponentByHandle(LS_Squeezer* squeezer, const LS_Handle handle) {
+		return (*squeezer)[handle];
+	}
+
+	void LS_Destroy(LS_Squeezer* squeezer) {
+		delete squeezer;
+	}
+
+	void LS_RunBatch(LS_BatchJob* jobs, int count, int threads) {
+		lsqueezer::RunBatch(jobs, count, threads);
 	}
 }
\ No newline at end of file
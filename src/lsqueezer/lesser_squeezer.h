@@ -19,38 +19,82 @@
 #pragma once
 #include "../ace.h"
 #include "../AtlasComponent.h"	// I couldn't forward declare it for some weird reason????
+#include "ls_flags.h"
 #include <raylib.h>
 
+#define LS_BAKED_TYPE ".lsatlas"	// ace entry type of atlases baked by ace's Generate()
+
+/* Handle:
+	Index of a component inside an atlas; resolve it once from a tag with GetHandle() and use it
+	for every later lookup. A tag keeps its handle for as long as its lsqueezer lives.
+	*/
+typedef int LS_Handle;
+#define LS_INVALID_HANDLE -1
+
+#ifdef __cplusplus
+class lsqueezer;
+typedef lsqueezer LS_Squeezer;
+#else
+typedef struct lsqueezer LS_Squeezer;
+#endif
+
+/* BatchJob:
+	An atlas for RunBatch() to build from ace tags; every job needs its own squeezer.
+	*/
+typedef struct {
+	LS_Squeezer* squeezer;
+	const char** tags;
+	int size;
+	Image result;	// Output; same as RunTags()
+} LS_BatchJob;
+
 #ifdef __cplusplus
-#include <map>
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #define EX_LS_FUNCTION(x) x
 
-typedef std::map<std::string, AtlasComponent> AtlasMap;
-
 class lsqueezer {
 	const bool verbose_;
 	const size_t bin_width_;
 	const size_t bin_height_;
-	AtlasMap map_;
+	const int flags_;
+	int encode_threads_ = 0;	// Block encoder workers (see ls::Settings); set by RunBatch()
+	std::vector<AtlasComponent> components_;	// Indexed by LS_Handle
+	std::unordered_map<std::string, LS_Handle> handles_;
+	static inline const AtlasComponent empty_ = { 0 };
 
 	Image inline CreateBinFromEntries(std::vector<ace_entry>& entries);
+	Image inline CreateBin(const std::vector<std::string>& ids, const std::function<ace_entry(size_t)>& fetch, const bool release);
+	void inline SetComponent(const std::string& tag, const AtlasComponent& component);
 
 public:
 
-	lsqueezer(const size_t w, const size_t h, const bool verbose = false) : bin_height_(h), bin_width_(w), verbose_(verbose) {
+	lsqueezer(const size_t w, const size_t h, const bool verbose = false, const int flags = LS_FLAG_NONE) :
+		bin_height_(h), bin_width_(w), verbose_(verbose), flags_(flags) {
 		puts("LSQUEEZER: Context created");
 	};
-	AtlasComponent& operator[](std::string& arg) { 
-		if (map_.count(arg) != 0) { return map_[arg]; }
-		return AtlasComponent{ 0 };
+
+	/* GetHandle():
+		Resolve a tag into a handle.
+
+		* Tag: the component's name; same as the file name/ace entry id;
+		* Returns: LS_INVALID_HANDLE if the tag isn't in the atlas.
+		*/
+	LS_Handle GetHandle(const std::string& tag) const {
+		auto it = handles_.find(tag);
+		return it != handles_.end() ? it->second : LS_INVALID_HANDLE;
 	}
-	AtlasComponent& operator[](const char* arg) {
-		if (map_.count(arg) != 0) { return map_[arg]; }
-		return AtlasComponent{ 0 };
+	LS_Handle GetHandle(const char* tag) const { return GetHandle(std::string(tag)); }
+
+	// A zeroed component is returned for invalid handles/unknown tags.
+	const AtlasComponent& operator[](const LS_Handle handle) const {
+		return (size_t)handle < components_.size() ? components_[handle] : empty_;
 	}
+	const AtlasComponent& operator[](const std::string& tag) const { return (*this)[GetHandle(tag)]; }
+	const AtlasComponent& operator[](const char* tag) const { return (*this)[GetHandle(tag)]; }
 
 	/* Run():
 		Create atlas from ace entries.
@@ -58,6 +102,32 @@ public:
 		* Entries: a vector of previously loaded ace entries.
 		*/
 	Image Run(ace_buffer& entries);
+
+	/* Bake():
+		Create atlas from ace entries and serialize it along with its components; used
+		by ace to store registered atlases (see ace's RegisterAtlas()).
+
+		* Entries: a vector of previously loaded ace entries;
+		* Returns: the serialized atlas, or an empty vector on failure.
+		*/
+	std::vector<unsigned char> Bake(ace_buffer& entries);
+
+	/* RunBatch():
+		Build several atlases concurrently; each job runs RunTags() on its squeezer.
+
+		* Jobs: the atlases to build;
+		* Count: number of elements inside 'jobs';
+		* Threads: worker count; 0 uses every hardware thread. Block-compressed atlases share
+		  the hardware threads between workers rather than each encoding on all of them.
+		*/
+	static void RunBatch(LS_BatchJob* jobs, int count, int threads = 0);
+
+	/* EnableBaking():
+		Lets ace bake registered atlases with lsqueezer (see ace's RegisterAtlas()); call it
+		before registering any. Tools that only generate ace files need it too, or nothing of
+		lsqueezer gets linked in.
+		*/
+	static void EnableBaking();
 #else
 #define EX_LS_FUNCTION(x) LS_##x
 
@@ -70,6 +140,20 @@ public:
 		*/
 	void LS_Init(const int w, const int h, const bool verbose);
 
+	/* InitEx():
+		Same as LS_Init(), with packing flags.
+
+		* Flags: a combination of LS_Flags.
+		*/
+	void LS_InitEx(const int w, const int h, const bool verbose, const int flags);
+
+	/* EnableBaking():
+		Lets ace bake registered atlases with lsqueezer (see ace's Ace_RegisterAtlas()); call it
+		before registering any. Tools that only generate ace files need it too, or nothing of
+		lsqueezer gets linked in.
+		*/
+	void LS_EnableBaking();
+
 	/* GetComponent():
 		Get a component's data.
 
@@ -79,10 +163,50 @@ public:
 		*/
 	AtlasComponent LS_GetComponent(const char* name);
 
+	/* GetHandle():
+		Resolve a tag into a handle for LS_GetComponentByHandle().
+
+		* Name: the component's name; same as the file name/ace entry id.
+		* NOTE: if no match to an id is found, it returns LS_INVALID_HANDLE.
+		*/
+	LS_Handle LS_GetHandle(const char* name);
+
+	/* GetComponentByHandle():
+		Get a component's data from a handle; just an array access.
+
+		* NOTE: if the handle is invalid, it returns a NULL struct.
+		*/
+	AtlasComponent LS_GetComponentByHandle(const LS_Handle handle);
+
 	/* Stop():
 		Cleans up static data.
 		*/
 	void LS_Stop();
+
+	/* Instances:
+		C bindings of the 'lsqueezer' class, for when one static context isn't enough; every
+		LS_Create() must be paired with a call to LS_Destroy(). Instances share no state, so
+		different ones can be used from different threads.
+		*/
+	LS_Squeezer* LS_Create(const int w, const int h, const bool verbose, const int flags);
+	Image LS_SqueezerRunTags(LS_Squeezer* squeezer, const char** tags, int size);
+	Image LS_SqueezerRunDirectory(LS_Squeezer* squeezer, const char** tags, int size, const char* folder_path);
+	Image LS_SqueezerRunBaked(LS_Squeezer* squeezer, const char* name);
+	AtlasComponent LS_SqueezerGetComponent(LS_Squeezer* squeezer, const char* name);
+	LS_Handle LS_SqueezerGetHandle(LS_Squeezer* squeezer, const char* name);
+	AtlasComponent LS_SqueezerGetComponentByHandle(LS_Squeezer* squeezer, const LS_Handle handle);
+	void LS_Destroy(LS_Squeezer* squeezer);
+
+	/* RunBatch():
+		Build several atlases concurrently on a pool of worker threads; each job runs
+		LS_SqueezerRunTags() on its own squeezer.
+
+		* Jobs: the atlases to build; their 'result' is filled in;
+		* Count: number of elements inside 'jobs';
+		* Threads: worker count; 0 uses every hardware thread. Block-compressed atlases share
+		  the hardware threads between workers rather than each encoding on all of them.
+		*/
+	void LS_RunBatch(LS_BatchJob* jobs, int count, int threads);
 #endif
 	/* RunTags():
 		Create atlas from ace tags.
@@ -97,7 +221,7 @@ public:
 	/* RunDirectory():
 		Create atlas from files inside a directory.
 	
-		* Tags: an array of entry ids(names);
+		* Tags: an array of entry ids(names); matched against file names without their extension;
 		* Size: size of the tags array;
 		* Folder_path: a directory from which to load images from;
 		* NOTE: in case the requested entry id is not found in the folder, the function will
@@ -106,6 +230,14 @@ public:
 		*/
 	Image EX_LS_FUNCTION(RunDirectory(const char** tags, int size, const char* folder_path));
 
+	/* RunBaked():
+		Load an atlas baked into the ace file; no packing happens at runtime.
+
+		* Name: the name the atlas was registered with (see ace's RegisterAtlas());
+		* NOTE: the bin size given to lsqueezer is ignored; the atlas keeps its baked size.
+		*/
+	Image EX_LS_FUNCTION(RunBaked(const char* name));
+
 #ifdef __cplusplus
 };
 #endif
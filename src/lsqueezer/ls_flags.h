@@ -0,0 +1,27 @@
+/* ls_flags.h: lsqueezer's flags; shared by the raylib front-end & the headless core (see atlas_builder.h).
+	*/
+#pragma once
+
+/* Flags:
+	Optional packing behaviour; combine them with '|'.
+	*/
+typedef enum {
+	LS_FLAG_NONE = 0,
+	LS_FLAG_ALLOW_ROTATION = 1 << 0,	// Allow 90° rotations when they pack better (see AtlasComponent::rotated)
+	LS_FLAG_TRIM = 1 << 1,				// Only pack the opaque part of each image (see AtlasComponent::x_offset)
+	LS_FLAG_STREAM = 1 << 2,			// RunTags(): keep a couple of entries in memory at a time instead of all of them
+
+	// Pixel format of the atlas; pick one.
+	LS_FORMAT_RGBA8 = 0 << 8,				// PIXELFORMAT_UNCOMPRESSED_R8G8B8A8 (default)
+	LS_FORMAT_RGBA8_PREMULTIPLIED = 1 << 8,	// PIXELFORMAT_UNCOMPRESSED_R8G8B8A8, color multiplied by alpha
+	LS_FORMAT_RGBA4444 = 2 << 8,			// PIXELFORMAT_UNCOMPRESSED_R4G4B4A4
+	LS_FORMAT_RGB565 = 3 << 8,				// PIXELFORMAT_UNCOMPRESSED_R5G6B5; alpha is dropped
+	LS_FORMAT_ALPHA8 = 4 << 8,				// PIXELFORMAT_UNCOMPRESSED_GRAYSCALE holding alpha only
+
+	// Block-compressed formats, encoded on the CPU once the atlas is packed. The bin size must be a
+	// multiple of 4; every rect is padded to a multiple of 4 so no two images share a block.
+	LS_FORMAT_BC1 = 5 << 8,					// PIXELFORMAT_COMPRESSED_DXT1_RGBA; alpha < 128 is transparent
+	LS_FORMAT_BC3 = 6 << 8,					// PIXELFORMAT_COMPRESSED_DXT5_RGBA
+	LS_FORMAT_ETC2 = 7 << 8,				// PIXELFORMAT_COMPRESSED_ETC2_EAC_RGBA
+	LS_FORMAT_MASK = 0xF << 8,
+} LS_Flags;
@@ -0,0 +1,357 @@
+#include "pixel_ops.h"
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace ls {
+
+static const uint32_t kAlphaMask = 0xFF000000u;	// RGBA8 in memory order -> 'A' is the high byte
+
+#ifdef LS_SSE2
+static inline int LowestBit(unsigned int x) {
+#if defined(_MSC_VER)
+	unsigned long i; _BitScanForward(&i, x); return (int)i;
+#else
+	return __builtin_ctz(x);
+#endif
+}
+
+static inline int HighestBit(unsigned int x) {
+#if defined(_MSC_VER)
+	unsigned long i; _BitScanReverse(&i, x); return (int)i;
+#else
+	return 31 - __builtin_clz(x);
+#endif
+}
+
+// Bit 4*i is set when pixel i of the 4 loaded pixels is fully transparent.
+static inline unsigned int TransparentMask(const uint32_t* px) {
+	const __m128i v = _mm_loadu_si128((const __m128i*)px);
+	const __m128i a = _mm_and_si128(v, _mm_set1_epi32((int)kAlphaMask));
+	return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi32(a, _mm_setzero_si128())) & 0x1111;
+}
+#endif
+
+static bool RowHasAlpha(const uint32_t* row, int width) {
+	int x = 0;
+#ifdef LS_SSE2
+	for (; x + 16 <= width; x += 16) {
+		const __m128i mask = _mm_set1_epi32((int)kAlphaMask);
+		__m128i acc = _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x)), mask);
+		acc = _mm_or_si128(acc, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x + 4)), mask));
+		acc = _mm_or_si128(acc, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x + 8)), mask));
+		acc = _mm_or_si128(acc, _mm_and_si128(_mm_loadu_si128((const __m128i*)(row + x + 12)), mask));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, _mm_setzero_si128())) != 0xFFFF) { return true; }
+	}
+	for (; x + 4 <= width; x += 4) {
+		if (TransparentMask(row + x) != 0x1111) { return true; }
+	}
+#endif
+	for (; x < width; x++) {
+		if (row[x] & kAlphaMask) { return true; }
+	}
+	return false;
+}
+
+// First opaque pixel inside [begin, end); returns 'end' if there's none.
+static int FirstOpaque(const uint32_t* row, int begin, int end) {
+	int x = begin;
+#ifdef LS_SSE2
+	for (; x + 4 <= end; x += 4) {
+		const unsigned int opaque = ~TransparentMask(row + x) & 0x1111;
+		if (opaque) { return x + LowestBit(opaque) / 4; }
+	}
+#endif
+	for (; x < end; x++) {
+		if (row[x] & kAlphaMask) { return x; }
+	}
+	return end;
+}
+
+// Last opaque pixel inside [begin, end); returns 'begin - 1' if there's none.
+static int LastOpaque(const uint32_t* row, int begin, int end) {
+	int x = end;
+#ifdef LS_SSE2
+	for (; x - 4 >= begin; x -= 4) {
+		const unsigned int opaque = ~TransparentMask(row + x - 4) & 0x1111;
+		if (opaque) { return x - 4 + HighestBit(opaque) / 4; }
+	}
+#endif
+	for (; x > begin; x--) {
+		if (row[x - 1] & kAlphaMask) { return x - 1; }
+	}
+	return begin - 1;
+}
+
+rbp::Rect FindOpaqueBounds(const unsigned char* rgba, int width, int height) {
+	const uint32_t* px = (const uint32_t*)rgba;
+	int top = 0;
+	while (top < height && !RowHasAlpha(px + (size_t)top * width, width)) { top++; }
+	if (top == height) { return { 0, 0, 0, 0 }; }
+
+	int bottom = height - 1;
+	while (bottom > top && !RowHasAlpha(px + (size_t)bottom * width, width)) { bottom--; }
+
+	// Each row only needs to look at the columns outside of the bounds found so far.
+	int left = width;
+	int right = -1;
+	for (int y = top; y <= bottom; y++) {
+		const uint32_t* row = px + (size_t)y * width;
+		if (left > 0) {
+			left = FirstOpaque(row, 0, left);
+		}
+		if (right < width - 1) {
+			const int r = LastOpaque(row, right + 1, width);
+			if (r > right) { right = r; }
+		}
+	}
+	return { left, top, right - left + 1, bottom - top + 1 };
+}
+
+rbp::Rect PackedRegion(const unsigned char* rgba, int width, int height, bool trim) {
+	if (!trim) { return { 0, 0, width, height }; }
+	rbp::Rect bounds = FindOpaqueBounds(rgba, width, height);
+	if (bounds.width == 0) { return { 0, 0, 1, 1 }; }
+	return bounds;
+}
+
+int BytesPerPixel(Format format) {
+	switch (format) {
+	case Format::RGBA4444:
+	case Format::RGB565: return 2;
+	case Format::Alpha8: return 1;
+	default: return 4;
+	}
+}
+
+bool ExpandToRGBA8(const unsigned char* src, int channels, unsigned char* dst, size_t count) {
+	switch (channels) {
+	case 1:
+		for (size_t i = 0; i < count; i++, dst += 4) {
+			dst[0] = dst[1] = dst[2] = src[i];
+			dst[3] = 255;
+		}
+		return true;
+	case 2:
+		for (size_t i = 0; i < count; i++, src += 2, dst += 4) {
+			dst[0] = dst[1] = dst[2] = src[0];
+			dst[3] = src[1];
+		}
+		return true;
+	case 3:
+		for (size_t i = 0; i < count; i++, src += 3, dst += 4) {
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = 255;
+		}
+		return true;
+	case 4:
+		memcpy(dst, src, count * 4);
+		return true;
+	}
+	return false;
+}
+
+// round(x / 255) for x <= 255 * 255
+static inline unsigned int Div255(unsigned int x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static void ConvertScalar(const unsigned char* rgba, unsigned char* dst, size_t count, Format format) {
+	for (size_t i = 0; i < count; i++, rgba += 4) {
+		const unsigned int r = rgba[0], g = rgba[1], b = rgba[2], a = rgba[3];
+		switch (format) {
+		case Format::RGBA8Premultiplied:
+			dst[i * 4 + 0] = (unsigned char)Div255(r * a);
+			dst[i * 4 + 1] = (unsigned char)Div255(g * a);
+			dst[i * 4 + 2] = (unsigned char)Div255(b * a);
+			dst[i * 4 + 3] = (unsigned char)a;
+			break;
+		case Format::RGBA4444: {
+			const uint16_t px = (uint16_t)(Div255(r * 15) << 12 | Div255(g * 15) << 8 | Div255(b * 15) << 4 | Div255(a * 15));
+			memcpy(dst + i * 2, &px, 2);
+		} break;
+		case Format::RGB565: {
+			const uint16_t px = (uint16_t)(Div255(r * 31) << 11 | Div255(g * 63) << 5 | Div255(b * 31));
+			memcpy(dst + i * 2, &px, 2);
+		} break;
+		case Format::Alpha8:
+			dst[i] = (unsigned char)a;
+			break;
+		default:
+			memcpy(dst + i * 4, rgba, 4);
+			break;
+		}
+	}
+}
+
+#ifdef LS_SSE2
+static inline __m128i Div255(__m128i x) {
+	x = _mm_add_epi16(x, _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// Quantizes 2 pixels held as 16-bit lanes and packs each into the low 16 bits of 2 dwords
+// (lanes 0 and 2) using 'scale' (per channel maximum) and 'shift' (per channel multiplier).
+static inline __m128i Pack16(__m128i px, __m128i scale, __m128i shift) {
+	const __m128i q = Div255(_mm_mullo_epi16(px, scale));
+	const __m128i halves = _mm_madd_epi16(q, shift);
+	return _mm_add_epi32(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+}
+
+// 4 dwords holding values <= 0xFFFF -> 4 words.
+static inline __m128i NarrowU32(__m128i lo, __m128i hi) {
+	const __m128i packed = _mm_unpacklo_epi64(_mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 0, 2, 0)),
+		_mm_shuffle_epi32(hi, _MM_SHUFFLE(2, 0, 2, 0)));
+	const __m128i bias = _mm_set1_epi32(0x8000);
+	const __m128i narrow = _mm_packs_epi32(_mm_sub_epi32(packed, bias), _mm_sub_epi32(packed, bias));
+	return _mm_xor_si128(narrow, _mm_set1_epi16((short)0x8000));
+}
+#endif
+
+void ConvertPixels(const unsigned char* rgba, unsigned char* dst, size_t count, Format format) {
+	size_t i = 0;
+#ifdef LS_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	switch (format) {
+	case Format::RGBA8Premultiplied: {
+		const __m128i alpha_lanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			const __m128i a_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			const __m128i a_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+			lo = _mm_or_si128(_mm_andnot_si128(alpha_lanes, Div255(_mm_mullo_epi16(lo, a_lo))), _mm_and_si128(alpha_lanes, lo));
+			hi = _mm_or_si128(_mm_andnot_si128(alpha_lanes, Div255(_mm_mullo_epi16(hi, a_hi))), _mm_and_si128(alpha_lanes, hi));
+			_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(lo, hi));
+		}
+	} break;
+	case Format::RGBA4444:
+	case Format::RGB565: {
+		const bool is_4444 = format == Format::RGBA4444;
+		const __m128i scale = is_4444 ? _mm_set1_epi16(15) : _mm_set_epi16(0, 31, 63, 31, 0, 31, 63, 31);
+		const __m128i shift = is_4444 ? _mm_set_epi16(1, 16, 256, 4096, 1, 16, 256, 4096)
+			: _mm_set_epi16(0, 1, 32, 2048, 0, 1, 32, 2048);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128((const __m128i*)(rgba + i * 4));
+			const __m128i lo = Pack16(_mm_unpacklo_epi8(v, zero), scale, shift);
+			const __m128i hi = Pack16(_mm_unpackhi_epi8(v, zero), scale, shift);
+			_mm_storel_epi64((__m128i*)(dst + i * 2), NarrowU32(lo, hi));
+		}
+	} break;
+	case Format::Alpha8:
+		for (; i + 16 <= count; i += 16) {
+			const __m128i* src = (const __m128i*)(rgba + i * 4);
+			const __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(src), 24);
+			const __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(src + 1), 24);
+			const __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(src + 2), 24);
+			const __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(src + 3), 24);
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3)));
+		}
+		break;
+	default:
+		break;
+	}
+#endif
+	const int bpp = BytesPerPixel(format);
+	ConvertScalar(rgba + i * 4, dst + i * bpp, count - i, format);
+}
+
+void BlitPixels(unsigned char* dst, int dst_width, const unsigned char* src, int src_width,
+	const rbp::Rect& region, int x, int y, bool rotated, int bytes_per_pixel) {
+	const size_t bpp = (size_t)bytes_per_pixel;
+	const unsigned char* src_px = src + ((size_t)region.y * src_width + region.x) * bpp;
+	unsigned char* dst_px = dst + ((size_t)y * dst_width + x) * bpp;
+	if (!rotated) {
+		for (int y_src = 0; y_src < region.height; y_src++) {
+			memcpy(dst_px + (size_t)y_src * dst_width * bpp, src_px + (size_t)y_src * src_width * bpp, region.width * bpp);
+		}
+		return;
+	}
+
+	// Source pixel (x, y) lands on (height - 1 - y, x).
+	for (int x_src = 0; x_src < region.width; x_src++) {
+		unsigned char* row = dst_px + (size_t)x_src * dst_width * bpp;
+		for (int y_src = 0; y_src < region.height; y_src++) {
+			memcpy(row + (region.height - 1 - y_src) * bpp, src_px + ((size_t)y_src * src_width + x_src) * bpp, bpp);
+		}
+	}
+}
+
+void BlitConverted(unsigned char* dst, int dst_width, const unsigned char* rgba, int src_width,
+	const rbp::Rect& region, int x, int y, bool rotated, Format format) {
+	if (format == Format::RGBA8) {
+		BlitPixels(dst, dst_width, rgba, src_width, region, x, y, rotated);
+		return;
+	}
+
+	const size_t bpp = (size_t)BytesPerPixel(format);
+	const unsigned char* src_px = rgba + ((size_t)region.y * src_width + region.x) * 4;
+	if (!rotated) {
+		for (int y_src = 0; y_src < region.height; y_src++) {
+			ConvertPixels(src_px + (size_t)y_src * src_width * 4, dst + ((size_t)(y + y_src) * dst_width + x) * bpp,
+				region.width, format);
+		}
+		return;
+	}
+
+	// Convert first so rotating only has to move whole pixels around.
+	std::vector<unsigned char> converted((size_t)region.width * region.height * bpp);
+	for (int y_src = 0; y_src < region.height; y_src++) {
+		ConvertPixels(src_px + (size_t)y_src * src_width * 4, converted.data() + (size_t)y_src * region.width * bpp,
+			region.width, format);
+	}
+	BlitPixels(dst, dst_width, converted.data(), region.width, { 0, 0, region.width, region.height }, x, y, true, (int)bpp);
+}
+
+static inline uint64_t HashMix(uint64_t h, uint64_t v) {
+	h ^= v * 0x9E3779B97F4A7C15ull;
+	h = (h << 31) | (h >> 33);
+	return h * 0xBF58476D1CE4E5B9ull;
+}
+
+uint64_t HashPixels(const unsigned char* rgba, int width, const rbp::Rect& region) {
+	uint64_t h = HashMix(0, ((uint64_t)region.width << 32) | (uint32_t)region.height);
+	const size_t row_bytes = (size_t)region.width * 4;
+	for (int y = 0; y < region.height; y++) {
+		const unsigned char* row = rgba + ((size_t)(region.y + y) * width + region.x) * 4;
+		size_t i = 0;
+		for (; i + 8 <= row_bytes; i += 8) {
+			uint64_t v;
+			memcpy(&v, row + i, 8);
+			h = HashMix(h, v);
+		}
+		if (i < row_bytes) {
+			uint32_t v;
+			memcpy(&v, row + i, 4);	// Rows are always a multiple of 4 bytes
+			h = HashMix(h, v);
+		}
+	}
+	return h ^ (h >> 29);
+}
+
+bool PixelsEqual(const unsigned char* a, int a_width, const rbp::Rect& a_region,
+	const unsigned char* b, int b_width, const rbp::Rect& b_region) {
+	if (a_region.width != b_region.width || a_region.height != b_region.height) { return false; }
+	const size_t row_bytes = (size_t)a_region.width * 4;
+	for (int y = 0; y < a_region.height; y++) {
+		const unsigned char* row_a = a + ((size_t)(a_region.y + y) * a_width + a_region.x) * 4;
+		const unsigned char* row_b = b + ((size_t)(b_region.y + y) * b_width + b_region.x) * 4;
+		if (memcmp(row_a, row_b, row_bytes) != 0) { return false; }
+	}
+	return true;
+}
+
+}
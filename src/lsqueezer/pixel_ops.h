@@ -0,0 +1,93 @@
+/* pixel_ops.*: pixel kernels used by lsqueezer while building atlases.
+	Every function expects tightly packed RGBA8 data unless stated otherwise.
+	*/
+#pragma once
+#include "Rect.h"
+#include <stdint.h>
+#include <stddef.h>
+
+namespace ls {
+
+/* Format:
+	Pixel formats atlases can be written in; same order as the LS_FORMAT_* flags.
+	*/
+enum class Format {
+	RGBA8,				// As decoded
+	RGBA8Premultiplied,	// Color multiplied by alpha
+	RGBA4444,			// 16-bit, 'r << 12 | g << 8 | b << 4 | a'
+	RGB565,				// 16-bit, 'r << 11 | g << 5 | b'; alpha is dropped
+	Alpha8,				// Alpha only
+};
+
+/* BytesPerPixel():
+	Size of a pixel in 'format'.
+	*/
+int BytesPerPixel(Format format);
+
+/* ExpandToRGBA8():
+	Converts 8-bit grayscale (1 channel), grayscale + alpha (2) or RGB (3) pixels into RGBA8.
+
+	* Src: pixel data with 'channels' bytes per pixel;
+	* Dst: output; 'count' * 4 bytes;
+	* Returns: false if 'channels' is not supported.
+	*/
+bool ExpandToRGBA8(const unsigned char* src, int channels, unsigned char* dst, size_t count);
+
+/* ConvertPixels():
+	Converts a run of RGBA8 pixels into 'format', rounding to the nearest representable value.
+
+	* Dst: output; 'count' * BytesPerPixel(format) bytes.
+	*/
+void ConvertPixels(const unsigned char* rgba, unsigned char* dst, size_t count, Format format);
+
+/* FindOpaqueBounds():
+	Finds the smallest rect containing every pixel whose alpha is not 0.
+
+	* Rgba: pixel data;
+	* Width, Height: image dimensions;
+	* Returns: the bounds, or a rect of size (0,0) if the image is fully transparent.
+	*/
+rbp::Rect FindOpaqueBounds(const unsigned char* rgba, int width, int height);
+
+/* PackedRegion():
+	Region of an image that gets packed: the whole image, or its opaque bounds when
+	trimming. Fully transparent images keep a single pixel so they still get a spot.
+	*/
+rbp::Rect PackedRegion(const unsigned char* rgba, int width, int height, bool trim);
+
+/* BlitPixels():
+	Copies a region of an image into another one of the same format.
+
+	* Dst, Dst_width: destination pixels and their row stride;
+	* Src, Src_width: source pixels and their row stride;
+	* Region: part of the source to copy;
+	* X, Y: destination of the region's top-left corner;
+	* Rotated: rotate the region 90° clockwise; it then takes 'height' x 'width' pixels;
+	* Bytes_per_pixel: 1, 2 or 4.
+	*/
+void BlitPixels(unsigned char* dst, int dst_width, const unsigned char* src, int src_width,
+	const rbp::Rect& region, int x, int y, bool rotated, int bytes_per_pixel = 4);
+
+/* BlitConverted():
+	Same as BlitPixels(), converting RGBA8 source pixels into the destination's 'format'.
+	*/
+void BlitConverted(unsigned char* dst, int dst_width, const unsigned char* rgba, int src_width,
+	const rbp::Rect& region, int x, int y, bool rotated, Format format);
+
+/* HashPixels():
+	Hashes a region of an image, size included; a 64-bit hash can still collide, so matching
+	hashes must be confirmed with PixelsEqual().
+
+	* Rgba: pixel data;
+	* Width: width of the whole image (row stride);
+	* Region: part of the image to hash.
+	*/
+uint64_t HashPixels(const unsigned char* rgba, int width, const rbp::Rect& region);
+
+/* PixelsEqual():
+	Compares two image regions pixel by pixel.
+	*/
+bool PixelsEqual(const unsigned char* a, int a_width, const rbp::Rect& a_region,
+	const unsigned char* b, int b_width, const rbp::Rect& b_region);
+
+}
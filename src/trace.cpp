@@ -0,0 +1,116 @@
+#include "trace.h"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+namespace trace {
+
+uint64_t Now() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef ACE_INSTRUMENT
+struct trace_event {
+	const char* category;
+	const char* name;
+	std::string detail;
+	uint64_t start;
+	uint64_t end;
+	int thread;
+};
+
+static std::atomic<bool> s_capturing(false);
+static std::mutex s_events_mutex;	// Guards 's_events' & 's_origin'
+static std::vector<trace_event> s_events;
+static uint64_t s_origin = 0;	// Timestamps are exported relative to Start()
+
+// Small, stable thread ids read better in trace viewers than hashed std::thread::ids.
+static int ThreadId() {
+	static std::atomic<int> s_next_thread(1);
+	static thread_local int t_thread = s_next_thread++;
+	return t_thread;
+}
+
+static void AppendEscaped(std::string& out, const char* text) {
+	for (const char* c = text; *c; c++) {
+		if (*c == '"' || *c == '\\') { out += '\\'; out += *c; }
+		else if ((unsigned char)*c < 0x20) {
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+			out += escaped;
+		}
+		else { out += *c; }
+	}
+}
+
+void Start() {
+	std::lock_guard<std::mutex> lock(s_events_mutex);
+	s_events.clear();
+	s_origin = Now();
+	s_capturing = true;
+}
+
+bool Stop(const char* path) {
+	std::vector<trace_event> events;
+	uint64_t origin = 0;
+	{
+		std::lock_guard<std::mutex> lock(s_events_mutex);
+		if (!s_capturing) { return false; }
+		s_capturing = false;
+		events.swap(s_events);
+		origin = s_origin;
+	}
+
+	// Complete ("X") events; times are in microseconds.
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	char numbers[96];
+	for (size_t i = 0; i < events.size(); i++) {
+		const trace_event& event = events[i];
+		if (i != 0) { json += ','; }
+		json += "{\"cat\":\"";
+		AppendEscaped(json, event.category);
+		json += "\",\"name\":\"";
+		AppendEscaped(json, event.name);
+		snprintf(numbers, sizeof(numbers), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+			event.thread, (event.start - origin) / 1e3, (event.end - event.start) / 1e3);
+		json += numbers;
+		if (!event.detail.empty()) {
+			json += ",\"args\":{\"detail\":\"";
+			AppendEscaped(json, event.detail.c_str());
+			json += "\"}";
+		}
+		json += '}';
+	}
+	json += "]}\n";
+
+	FILE* file = fopen(path, "wb");
+	if (file == NULL) {
+		printf("ERROR AT " __FUNCTION__ ": Could not write the trace! (%s)\n", path);
+		return false;
+	}
+	fwrite(json.data(), 1, json.size(), file);
+	fclose(file);
+	return true;
+}
+
+void Record(const char* category, const char* name, const char* detail, uint64_t start, uint64_t end) {
+	if (!s_capturing.load(std::memory_order_relaxed)) { return; }
+	const int thread = ThreadId();
+	std::lock_guard<std::mutex> lock(s_events_mutex);
+	if (!s_capturing || start < s_origin) { return; }	// Spans begun before Start() are dropped
+	s_events.push_back({ category, name, detail != nullptr ? detail : "", start, end, thread });
+}
+#else
+void Start() {}
+
+bool Stop(const char*) {
+	return false;
+}
+
+void Record(const char*, const char*, const char*, uint64_t, uint64_t) {}
+#endif
+
+}
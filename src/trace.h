@@ -0,0 +1,84 @@
+/* trace.*: runtime instrumentation shared by ace & lsqueezer; counters, timers & trace spans.
+	Everything here compiles to nothing unless ACE_INSTRUMENT is defined (see aceconfig.h), so
+	the macros can sit on hot paths. Captured spans are exported as Chrome trace JSON, which
+	chrome://tracing & Perfetto open as is.
+	*/
+#pragma once
+#include "aceconfig.h"
+#include <stdint.h>
+#include <atomic>
+
+namespace trace {
+
+/* Now():
+	Steady clock, in nanoseconds.
+	*/
+uint64_t Now();
+
+/* Start(), Stop():
+	Begin capturing spans, discarding any captured earlier; Stop() writes what was captured to
+	'path' as Chrome trace JSON;
+
+	* Returns: false if instrumentation is compiled out, nothing is being captured or the file
+	  couldn't be written.
+	*/
+void Start();
+bool Stop(const char* path);
+
+/* Record():
+	Adds a span to the capture; ignored when nothing is being captured;
+
+	* Category, Name: string literals; they're kept as pointers;
+	* Detail: optional text shown with the span (an entry id, ...); copied;
+	* Start, End: as returned by Now().
+	*/
+void Record(const char* category, const char* name, const char* detail, uint64_t start, uint64_t end);
+
+/* Span:
+	Records the scope it lives in; use ACE_TRACE_SCOPE() rather than this directly.
+	*/
+class Span {
+	const char* category_;
+	const char* name_;
+	const char* detail_;
+	uint64_t start_;
+
+public:
+	Span(const char* category, const char* name, const char* detail = nullptr) :
+		category_(category), name_(name), detail_(detail), start_(Now()) {}
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+	~Span() { Record(category_, name_, detail_, start_, Now()); }
+};
+
+/* Timer:
+	Adds the time spent in its scope to a counter, in nanoseconds; use ACE_STAT_TIME().
+	*/
+class Timer {
+	std::atomic<uint64_t>& total_;
+	uint64_t start_;
+
+public:
+	Timer(std::atomic<uint64_t>& total) : total_(total), start_(Now()) {}
+	Timer(const Timer&) = delete;
+	Timer& operator=(const Timer&) = delete;
+	~Timer() { total_.fetch_add(Now() - start_, std::memory_order_relaxed); }
+};
+
+}
+
+#define EX_ACE_TRACE_CONCAT_(a, b) a##b
+#define EX_ACE_TRACE_CONCAT(a, b) EX_ACE_TRACE_CONCAT_(a, b)
+
+#ifdef ACE_INSTRUMENT
+// Span covering the rest of the scope; 'detail' may be NULL.
+#define ACE_TRACE_SCOPE(category, name, detail) trace::Span EX_ACE_TRACE_CONCAT(ace_span_, __LINE__)(category, name, detail)
+// Adds 'value' to an std::atomic<uint64_t> counter.
+#define ACE_STAT_ADD(counter, value) (counter).fetch_add((uint64_t)(value), std::memory_order_relaxed)
+// Adds the time spent in the rest of the scope to an std::atomic<uint64_t> counter.
+#define ACE_STAT_TIME(counter) trace::Timer EX_ACE_TRACE_CONCAT(ace_timer_, __LINE__)(counter)
+#else
+#define ACE_TRACE_SCOPE(category, name, detail) ((void)0)
+#define ACE_STAT_ADD(counter, value) ((void)0)
+#define ACE_STAT_TIME(counter) ((void)0)
+#endif